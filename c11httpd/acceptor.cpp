@@ -10,15 +10,27 @@
 #include "c11httpd/http_processor.h"
 #include "c11httpd/link.h"
 #include "c11httpd/socket.h"
+#include "c11httpd/utility.h"
 #include "c11httpd/waitable.h"
+#include <algorithm>
 #include <cstring>
 #include <cerrno>
+#include <new>
 #include <sys/epoll.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/wait.h>
 #include <signal.h>
 #include <sys/signalfd.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <unistd.h>
+
+
+// EPOLLEXCLUSIVE is available since Linux kernel 4.5.
+#ifndef EPOLLEXCLUSIVE
+#define EPOLLEXCLUSIVE (1u << 28)
+#endif
 
 
 namespace c11httpd {
@@ -45,407 +57,1386 @@ void acceptor_t::close() {
 	this->m_listens.clear();
 }
 
-err_t acceptor_t::bind(uint16_t port) {
-	return this->bind(std::string(), port);
+err_t acceptor_t::bind(uint16_t port) {
+	return this->bind(std::string(), port);
+}
+
+err_t acceptor_t::bind(const std::string& ip, uint16_t port) {
+	err_t ret;
+
+	if (ip.empty()) {
+		ret = this->bind_ipv4(ipv4_any, port);
+		if (!ret) {
+			return ret;
+		}
+
+		ret = this->bind_ipv6(ipv6_any, port);
+		if (!ret) {
+			this->m_listens.resize(this->m_listens.size() - 1);
+		}
+	} else {
+		if (ip.find(':') == std::string::npos) {
+			ret = this->bind_ipv4(ip, port);
+		} else {
+			ret = this->bind_ipv6(ip, port);
+		}
+	}
+
+	return ret;
+}
+
+err_t acceptor_t::bind_ipv4(const std::string& ip, uint16_t port) {
+	err_t ret;
+	socket_t sd;
+	const std::string& real_ip = ip.empty() ? ipv4_any : ip;
+
+	ret = this->listen_i(real_ip, port, false, &sd);
+	if (!ret) {
+		return ret;
+	}
+
+	this->m_listens.emplace_back(new listen_t(sd, real_ip, port, false));
+	return ret;
+}
+
+err_t acceptor_t::bind_ipv6(const std::string& ip, uint16_t port) {
+	err_t ret;
+	socket_t sd;
+	const std::string& real_ip = ip.empty() ? ipv6_any : ip;
+
+	ret = this->listen_i(real_ip, port, true, &sd);
+	if (!ret) {
+		return ret;
+	}
+
+	this->m_listens.emplace_back(new listen_t(sd, real_ip, port, true));
+	return ret;
+}
+
+err_t acceptor_t::listen_i(const std::string& ip, uint16_t port, bool ipv6, socket_t* sd) {
+	err_t ret;
+
+	assert(sd != 0);
+
+	ret = ipv6 ? sd->new_ipv6_nonblock() : sd->new_ipv4_nonblock();
+	if (!ret) {
+		goto clean;
+	}
+
+	if (this->m_config.enabled(config_t::reuse_port)) {
+		ret = sd->reuseport(true);
+		if (!ret) {
+			goto clean;
+		}
+	}
+
+	ret = ipv6 ? sd->bind_ipv6(ip, port) : sd->bind_ipv4(ip, port);
+	if (!ret) {
+		goto clean;
+	}
+
+	ret = sd->listen(this->m_config.backlog());
+	if (!ret) {
+		goto clean;
+	}
+
+clean:
+
+	if (!ret) {
+		sd->close();
+	}
+
+	return ret;
+}
+
+err_t acceptor_t::bind(std::initializer_list<std::pair<std::string, uint16_t>> list) {
+	err_t ret;
+	const size_t old_size = this->m_listens.size();
+
+	for (auto it = list.begin(); it != list.end(); ++it) {
+		ret = this->bind((*it).first.c_str(), (*it).second);
+
+		if (!ret) {
+			this->m_listens.resize(old_size);
+			return ret;
+		}
+	}
+
+	return ret;
+}
+
+std::vector<std::pair<std::string, uint16_t>> acceptor_t::binds() const {
+	std::vector<std::pair<std::string, uint16_t>> vt;
+
+	vt.reserve(this->m_listens.size());
+	for (auto it = this->m_listens.cbegin(); it != this->m_listens.cend(); ++it) {
+		vt.push_back(std::pair<std::string, uint16_t>((*it)->ip(), (*it)->port()));
+	}
+
+	return vt;
+}
+
+err_t acceptor_t::run_tcp(conn_event_t* handler) {
+	err_t ret;
+	running_t running(handler);
+
+	assert(handler != 0);
+
+	this->m_stats.clear();
+	running.m_stats = &this->m_stats;
+	this->m_aio_pool.threads(this->m_config.aio_threads());
+	this->m_aio_pool.start();
+
+	// In SO_REUSEPORT mode, each worker process (or worker thread) listens to
+	// its own sockets. Close the original listening sockets, otherwise
+	// Linux kernel would still distribute some connections to them.
+	if (this->m_config.enabled(config_t::reuse_port)
+		&& (this->m_config.worker_processes() > 0 || this->m_config.worker_threads() > 0)) {
+		for (auto it = this->m_listens.begin(); it != this->m_listens.end(); ++it) {
+			(*it)->close();
+		}
+	}
+
+	// Create worker processes.
+	if (this->m_config.worker_processes() > 0) {
+		ret = this->m_worker_pool.create(this->m_config.worker_processes());
+		if (!ret) {
+			goto clean;
+		}
+	}
+
+	// Create epoll handle, and hook Linux signals.
+	//
+	// Note that Linux signals must be blocked before creating worker threads,
+	// so that worker threads inherit the signal mask.
+	ret = this->open_running_i(&running, true);
+	if (!ret) {
+		goto clean;
+	}
+
+	// Add listening sockets, or create worker threads to do it.
+	if (this->m_config.worker_processes() == 0 || !this->m_worker_pool.main_process()) {
+		if (this->m_config.worker_threads() > 0) {
+			ret = this->start_threads_i(handler);
+		} else {
+			ret = this->add_listens_i(&running);
+		}
+
+		if (!ret) {
+			goto clean;
+		}
+	}
+
+	ret = this->run_loop_i(&running);
+
+clean:
+
+	// Stop I/O threads first, so that no AIO task is pushed to event loops
+	// that are being closed. The pool stays stopped (new tasks fail with
+	// ECANCELED) while worker threads are stopped and event loops are closed.
+	this->m_aio_pool.stop();
+	this->stop_threads_i();
+	this->close_running_i(&running);
+
+	// Kill all worker process.
+	this->m_worker_pool.kill_all();
+
+	return ret;
+}
+
+err_t acceptor_t::open_running_i(running_t* running, bool main_thread) {
+	err_t ret;
+
+	assert(running != 0);
+
+	// Create epoll handle.
+	running->m_epoll = epoll_create1(EPOLL_CLOEXEC);
+	if (!running->m_epoll.is_open()) {
+		return err_t::current();
+	}
+
+	running->m_buf_pool.limit(size_t(this->m_config.buf_pool_limit()));
+
+	// Create AIO completion queue.
+	ret = running->m_aio_queue.open();
+	if (!ret) {
+		return ret;
+	}
+
+	ret = this->epoll_set_i(running->m_epoll, running->m_aio_queue.fd().get(),
+		&running->m_aio_queue, EPOLL_CTL_ADD, EPOLLIN | EPOLLET);
+	if (!ret) {
+		return ret;
+	}
+
+	if (main_thread) {
+		// Hook Linux signals.
+		ret = this->signalfd_i(&running->m_signal);
+		if (!ret) {
+			return ret;
+		}
+
+		// Add signal fd to epoll.
+		ret = this->epoll_set_i(running->m_epoll, running->m_signal.get(),
+			&running->m_waitable_signal, EPOLL_CTL_ADD, EPOLLIN | EPOLLET);
+	} else {
+		// Worker threads do not handle Linux signals,
+		// they are notified by main thread via event fd.
+		running->m_event = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if (!running->m_event.is_open()) {
+			return err_t::current();
+		}
+
+		ret = this->epoll_set_i(running->m_epoll, running->m_event.get(),
+			&running->m_waitable_event, EPOLL_CTL_ADD, EPOLLIN | EPOLLET);
+	}
+
+	return ret;
+}
+
+void acceptor_t::close_running_i(running_t* running) {
+	assert(running != 0);
+
+	// Close io_uring first, so that kernel stops using buffers of connections.
+	running->m_uring.close();
+	running->m_send_queue.clear();
+	running->m_ready_list.clear();
+	running->m_accept_list.clear();
+
+	// Trigger "on_disconnected" event for each existing connection.
+	do {
+		const config_t* cfg = &this->m_config;
+		conn_event_t* handler = running->m_handler;
+		running->m_used_list.for_each([this, running, handler, cfg](conn_t* c) {
+			handler->on_disconnected(*c, *cfg, *c);
+			this->delete_conn_i(running, c);
+		});
+	} while (0);
+
+	running->m_aio_wait_list.for_each([this, running](conn_t* c) {
+		this->delete_conn_i(running, c);
+	});
+
+	running->m_closed_list.for_each([this, running](conn_t* c) {
+		this->delete_conn_i(running, c);
+	});
+
+	running->m_free_list.for_each([this, running](conn_t* c) {
+		this->delete_conn_i(running, c);
+	});
+
+	if (running->m_slab != 0) {
+		::operator delete((void*) running->m_slab);
+		running->m_slab = 0;
+		running->m_slab_count = 0;
+	}
+
+	running->m_used_count = 0;
+	running->m_aio_wait_count = 0;
+	running->m_free_count = 0;
+	running->m_batching = false;
+
+	running->m_epoll.close();
+	running->m_signal.close();
+	running->m_event.close();
+	running->m_aio_queue.close();
+	running->m_accepts.clear();
+	running->m_listens.clear();
+	running->m_serving = false;
+}
+
+err_t acceptor_t::add_listens_i(running_t* running) {
+	err_t ret;
+
+	assert(running != 0);
+
+	// In SO_REUSEPORT mode, each worker process (or worker thread)
+	// listens to its own sockets.
+	const bool own = this->m_config.enabled(config_t::reuse_port)
+		&& (this->m_config.worker_processes() > 0 || this->m_config.worker_threads() > 0);
+
+	for (auto it = this->m_listens.begin(); it != this->m_listens.end(); ++it) {
+		listen_t* listen = (*it).get();
+
+		if (own) {
+			socket_t sd;
+
+			ret = this->listen_i(listen->ip(), listen->port(), listen->ipv6(), &sd);
+			if (!ret) {
+				return ret;
+			}
+
+			running->m_listens.emplace_back(new listen_t(sd, listen->ip(), listen->port(), listen->ipv6()));
+			listen = running->m_listens.back().get();
+		}
+
+		running->m_accepts.push_back(listen);
+
+		// In io_uring mode, listening sockets are added by loop_uring_i().
+		if (this->m_config.engine() == config_t::engine_epoll) {
+			ret = this->epoll_set_i(running->m_epoll, listen->sock(), listen, EPOLL_CTL_ADD, this->listen_events_i());
+			if (!ret) {
+				return ret;
+			}
+		}
+	}
+
+	running->m_serving = true;
+	this->prealloc_conns_i(running);
+
+	return ret;
+}
+
+err_t acceptor_t::start_threads_i(conn_event_t* handler) {
+	err_t ret;
+
+	assert(this->m_threads.empty());
+
+	for (int i = 0; i < this->m_config.worker_threads(); ++i) {
+		auto running = new running_t(handler);
+
+		this->m_thread_runnings.emplace_back(running);
+		running->m_stats = &running->m_own_stats;
+
+		ret = this->open_running_i(running, false);
+		if (!ret) {
+			return ret;
+		}
+
+		ret = this->add_listens_i(running);
+		if (!ret) {
+			return ret;
+		}
+	}
+
+	for (auto it = this->m_thread_runnings.begin(); it != this->m_thread_runnings.end(); ++it) {
+		running_t* running = (*it).get();
+
+		this->m_threads.emplace_back([this, running]() {
+			running->m_result = this->run_loop_i(running);
+			this->close_running_i(running);
+		});
+	}
+
+	return ret;
+}
+
+void acceptor_t::stop_threads_i() {
+	// Notify all worker threads to quit.
+	for (auto it = this->m_thread_runnings.begin(); it != this->m_thread_runnings.end(); ++it) {
+		running_t* running = (*it).get();
+
+		running->m_stop = true;
+		this->notify_i(running);
+	}
+
+	for (auto it = this->m_threads.begin(); it != this->m_threads.end(); ++it) {
+		(*it).join();
+	}
+
+	// Sum up statistics of all worker threads.
+	for (auto it = this->m_thread_runnings.begin(); it != this->m_thread_runnings.end(); ++it) {
+		this->m_stats.add((*it)->m_own_stats);
+		this->close_running_i((*it).get());
+	}
+
+	this->m_threads.clear();
+	this->m_thread_runnings.clear();
+}
+
+void acceptor_t::notify_i(running_t* running) {
+	assert(running != 0);
+
+	if (running->m_event.is_open()) {
+		const uint64_t value = 1;
+		const auto result = ::write(running->m_event.get(), &value, sizeof(value));
+		(void) result;
+	}
+}
+
+err_t acceptor_t::run_loop_i(running_t* running) {
+	assert(running != 0);
+
+	// The main thread of a management process (or a process having
+	// worker threads) only handles Linux signals, epoll is enough.
+	if (running->m_serving && this->m_config.engine() == config_t::engine_uring) {
+		return this->loop_uring_i(running);
+	} else {
+		return this->loop_i(running);
+	}
+}
+
+err_t acceptor_t::loop_i(running_t* running) {
+	err_t ret;
+	std::vector<struct epoll_event> events(this->m_config.max_epoll_events());
+	std::set<conn_t*> aio_conns; // Which connection has completed AIO tasks.
+
+	assert(running != 0);
+
+	while (true) {
+		// Close timed-out connections, and sleep until the next timer expires.
+		// If some connections used up their read budget (or some listening
+		// sockets reached accept batch limit), just poll new events.
+		const int timeout_ms = this->on_timers_i(running);
+		const bool ready = !running->m_ready_list.empty() || !running->m_accept_list.empty();
+		const int wait_result = epoll_wait(running->m_epoll.get(), &events[0], int(events.size()),
+			ready ? 0 : timeout_ms);
+
+		if (wait_result == -1) {
+			const auto e = err_t::current();
+
+			if (e == EINTR) {
+				continue;
+			} else {
+				ret.set(e);
+				break;
+			}
+		}
+
+		running->m_batching = true;
+
+		for (int i = 0; i < wait_result; ++i) {
+			auto waitable = (const waitable_t*) events[i].data.ptr;
+
+			if (waitable->wait_type() == waitable_t::type_signal
+				|| waitable->wait_type() == waitable_t::type_event) {
+				bool exit;
+
+				if (waitable->wait_type() == waitable_t::type_signal) {
+					ret = this->on_signalled_i(running, &exit);
+				} else {
+					ret = this->on_notified_i(running, &exit);
+				}
+
+				if (!ret || exit) {
+					return ret;
+				}
+
+				// A restarted worker process (see restart_worker_i())
+				// handles connections in io_uring mode.
+				if (running->m_serving && this->m_config.engine() == config_t::engine_uring) {
+					this->free_closed_i(running);
+					return this->loop_uring_i(running);
+				}
+			} else if (waitable->wait_type() == waitable_t::type_aio) {
+				this->on_aio_queue_i(running, &aio_conns);
+				this->on_aio_completed_i(running, &aio_conns);
+			} else if (waitable->wait_type() == waitable_t::type_listen) {
+				ret = this->on_accept_i(running, (listen_t*) waitable);
+				if (!ret) {
+					return ret;
+				}
+			} else if (waitable->wait_type() == waitable_t::type_conn) {
+				// The conn might have been closed by a previous event
+				// in the same batch (e.g. AIO completion), the object is
+				// still valid because it's freed after the batch.
+				if (((conn_t*) waitable)->sock().is_open()) {
+					this->on_conn_event_i(running, (conn_t*) waitable, events[i].events);
+				}
+			} else {
+				// Should not run here!
+				assert(false);
+			}
+		}
+
+		this->free_closed_i(running);
+
+		// Connections that used up their read budget continue here,
+		// after other connections of this wakeup have been served.
+		ret = this->on_ready_i(running);
+		if (!ret) {
+			return ret;
+		}
+	}
+
+	return ret;
+}
+
+void acceptor_t::on_aio_queue_i(running_t* running, std::set<conn_t*>* aio_conns) {
+	aio_node_t* node = running->m_aio_queue.pop_all();
+
+	aio_conns->clear();
+
+	while (node != 0) {
+		aio_node_t* const next = node->m_next;
+
+		// The node might be deleted by on_aio_completed_i().
+		conn_t* const conn = node->m_conn;
+		conn->on_aio_completed_i(node);
+		aio_conns->insert(conn);
+
+		node = next;
+	}
+}
+
+void acceptor_t::on_aio_completed_i(running_t* running, std::set<conn_t*>* aio_conns) {
+	conn_event_t* const handler = running->m_handler;
+
+	for (conn_t* conn : *aio_conns) {
+		// The connection was closed, garbage-collect it
+		// if all AIO tasks are completed.
+		if (conn->aio_wait_state()) {
+			this->gc_conn_i(running, conn, false);
+			continue;
+		}
+
+		// Popup AIO completed tasks.
+		conn->popup_aio_completed(&running->m_aio_completed);
+		if (running->m_aio_completed.empty()) {
+			continue;
+		}
+
+		// Invoke callback function to handle completed aio tasks.
+		conn->last_event_result(handler->on_aio_completed(
+			*conn, this->m_config, *conn, conn->aio_running_count(),
+			running->m_aio_completed, conn->send_buf()));
+
+		if (running->m_uring.is_open()) {
+			if (conn->pending_send_size() > 0) {
+				this->uring_send_i(running, conn);
+			} else if (conn->last_event_result() & conn_event_t::result_disconnect) {
+				this->uring_close_i(running, conn);
+				continue;
+			}
+		} else if (!this->try_send_i(running, conn)) {
+			// We need to garbage collect the conn.
+			this->gc_conn_i(running, conn, false);
+			continue;
+		}
+
+		conn->release_bufs();
+		this->arm_timer_i(running, conn);
+	}
+
+	// Remove aio-completed conn pointers.
+	aio_conns->clear();
+}
+
+err_t acceptor_t::on_accept_i(running_t* running, listen_t* listen) {
+	err_t ret;
+	conn_event_t* const handler = running->m_handler;
+	socket_t new_sd;
+	struct sockaddr_storage new_addr;
+	uint64_t accepted = 0;
+
+	while (true) {
+		conn_t* conn;
+		bool gc = false;
+
+		// Accept a bounded batch, so that existing connections are not starved.
+		// In EPOLLEXCLUSIVE mode (level-triggered), the rest would be reported
+		// by next epoll_wait(). Otherwise (edge-triggered), no more event comes,
+		// so the listening socket goes to accept list.
+		if (accepted >= uint64_t(this->m_config.max_accept_batch())) {
+			if (!this->m_config.enabled(config_t::exclusive_accept)) {
+				auto& list = running->m_accept_list;
+
+				if (std::find(list.begin(), list.end(), listen) == list.end()) {
+					list.push_back(listen);
+				}
+			}
+
+			break;
+		}
+
+		// Accept new connection, which is in non-blocking mode.
+		ret = listen->sock().accept(&new_sd, &new_addr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (!ret) {
+			if (ret == EAGAIN || ret == EWOULDBLOCK) {
+				ret.set_ok();
+			}
+
+			break;
+		}
+
+		++ accepted;
+		conn = this->new_conn_i(running, new_sd, &new_addr);
+
+		do {
+			// Trigger "on_connected" event.
+			conn->last_event_result(handler->on_connected(
+					*conn, this->m_config, *conn, conn->send_buf()));
+
+			// If no data to send and disconnect flag is on,
+			// then close connection.
+			if ((conn->last_event_result() & conn_event_t::result_disconnect) != 0
+				&& conn->pending_send_size() == 0) {
+				gc = true;
+				break;
+			}
+
+			// If there are data to send, then send it right now.
+			conn->writable(true);
+			if (!this->try_send_i(running, conn)) {
+				gc = true;
+				break;
+			}
+
+			// Add it to epoll list. Both directions are registered only once,
+			// readiness is tracked by conn_t::readable() & conn_t::writable().
+			ret = this->epoll_set_i(running->m_epoll, conn->sock(), conn, EPOLL_CTL_ADD,
+					EPOLLIN | EPOLLOUT | EPOLLET);
+
+			if (!ret) {
+				gc = true;
+				break;
+			}
+		} while (0);
+
+		if (gc) {
+			this->gc_conn_i(running, conn, true);
+		} else {
+			// Add it to used list.
+			running->m_used_list.push_back(conn->link_node());
+			running->m_used_count ++;
+			this->arm_timer_i(running, conn);
+		}
+
+		ret.set_ok();
+	}
+
+	running->m_stats->on_listen_wakeup(accepted);
+	return ret;
+}
+
+void acceptor_t::on_conn_event_i(running_t* running, conn_t* conn, uint32_t events) {
+	err_t ret;
+	conn_event_t* const handler = running->m_handler;
+	bool gc = false;
+	bool budget_used = false;
+
+	// Edge-triggered events are saved, until recv() or send() gets EAGAIN.
+	// Errors are reported by recv() or send().
+	if (events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) {
+		conn->writable(true);
+	}
+
+	if (events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+		conn->readable(true);
+	}
+
+	do {
+		// Send pending data (responses of previous requests, or AIO results).
+		if (!this->try_send_i(running, conn)) {
+			gc = true;
+			break;
+		}
+
+		// If client side does not read data, then stop receiving new data
+		// until socket buffer becomes writable again.
+		if (!conn->readable()
+			|| (conn->pending_send_size() > 0 && !conn->writable())) {
+			break;
+		}
+
+		size_t new_recv_size;
+		bool peer_closed;
+
+		// New data is ready to read.
+		const size_t budget = size_t(this->m_config.read_budget());
+
+		ret = conn->recv(budget, running->m_spill.back(budget), budget,
+			&new_recv_size, &peer_closed);
+		if (!ret) {
+			gc = true;
+			break;
+		}
+
+		budget_used = (new_recv_size >= budget);
+
+		// Trigger "on_received" event.
+		if (new_recv_size > 0) {
+			conn->last_event_result(handler->on_received(
+				*conn, this->m_config, *conn,
+				conn->recv_buf(), conn->send_buf()));
+		}
+
+		// Client side has closed connection.
+		if (peer_closed) {
+			gc = true;
+			break;
+		}
+
+		// Send response right away, most of the time it fits
+		// in socket buffer and no EPOLLOUT round-trip is needed.
+		if (!this->try_send_i(running, conn)) {
+			gc = true;
+			break;
+		}
+	} while (0);
+
+	// An error happened or client side closed connection,
+	// we need to garbage collect the conn.
+	if (gc) {
+		this->gc_conn_i(running, conn, false);
+		return;
+	}
+
+	// Read budget was used up, continue later. If receiving stopped because
+	// pending data could not be sent, then it's resumed by next EPOLLOUT.
+	if (budget_used && conn->readable() && !conn->ready_state()) {
+		conn->ready_state(true);
+		running->m_ready_list.push_back(conn);
+	}
+
+	conn->release_bufs();
+	this->arm_timer_i(running, conn);
+}
+
+err_t acceptor_t::on_ready_i(running_t* running) {
+	err_t ret;
+
+	// Listening sockets might be added to the list again.
+	if (!running->m_accept_list.empty()) {
+		std::vector<listen_t*> accepts;
+		accepts.swap(running->m_accept_list);
+
+		for (listen_t* listen : accepts) {
+			ret = this->on_accept_i(running, listen);
+			if (!ret) {
+				return ret;
+			}
+		}
+	}
+
+	if (running->m_ready_list.empty()) {
+		return ret;
+	}
+
+	// Connections might be added to the list again.
+	std::vector<conn_t*> ready;
+	ready.swap(running->m_ready_list);
+
+	for (conn_t* conn : ready) {
+		// It might have been garbage-collected by a previous one.
+		if (!conn->ready_state()) {
+			continue;
+		}
+
+		conn->ready_state(false);
+		this->on_conn_event_i(running, conn, 0);
+	}
+
+	// Keep the memory for next time.
+	if (running->m_ready_list.empty()) {
+		ready.clear();
+		running->m_ready_list.swap(ready);
+	}
+
+	return ret;
+}
+
+conn_t* acceptor_t::new_conn_i(running_t* running, socket_t sd,
+	const struct sockaddr_storage* addr) {
+	conn_t* conn;
+
+	assert(running != 0);
+
+	if (running->m_free_count > 0) {
+		// Pop an free conn object from free list.
+		running->m_free_count--;
+		conn = running->m_free_list.pop_front()->get();
+		conn->sock(sd);
+		conn->peer(addr);
+	} else {
+		// Create a new conn object, its buffers use memory pool of the event loop.
+		conn = new conn_t(sd, addr);
+		conn->pool(&running->m_buf_pool);
+	}
+
+	conn->owner(running);
+	conn->aio(&this->m_aio_pool, &running->m_aio_queue);
+	return conn;
+}
+
+err_t acceptor_t::loop_uring_i(running_t* running) {
+	err_t ret;
+	std::set<conn_t*> aio_conns; // Which connection has completed AIO tasks.
+	const struct io_uring_cqe* cqe;
+
+	assert(running != 0);
+
+	ret = running->m_uring.open(unsigned(this->m_config.max_epoll_events()));
+	if (!ret) {
+		return ret;
+	}
+
+	ret = running->m_uring.add_bufs(unsigned(this->m_config.uring_buffers()),
+		unsigned(this->m_config.uring_buffer_size()));
+	if (!ret) {
+		return ret;
+	}
+
+	// Linux signals (main thread) or event fd (worker thread).
+	if (running->m_signal.is_open()) {
+		ret = this->uring_poll_i(running, running->m_signal, &running->m_waitable_signal);
+	} else {
+		ret = this->uring_poll_i(running, running->m_event, &running->m_waitable_event);
+	}
+
+	if (!ret) {
+		return ret;
+	}
+
+	ret = this->uring_poll_i(running, running->m_aio_queue.fd(), &running->m_aio_queue);
+	if (!ret) {
+		return ret;
+	}
+
+	for (auto listen : running->m_accepts) {
+		ret = this->uring_accept_i(running, listen);
+		if (!ret) {
+			return ret;
+		}
+	}
+
+	while (true) {
+		// Close timed-out connections, then submit sending requests
+		// of all connections in one batch.
+		const int timeout_ms = this->on_timers_i(running);
+		this->uring_flush_i(running);
+
+		// Submit all new requests, and wait for completion entries
+		// until the next timer expires.
+		ret = running->m_uring.submit(1, timeout_ms);
+		if (!ret) {
+			// EBUSY or EAGAIN means completion queue is full,
+			// so handle completed entries first.
+			if (ret != EINTR && ret != EBUSY && ret != EAGAIN && ret != ETIME) {
+				break;
+			}
+
+			ret.set_ok();
+		}
+
+		while ((cqe = running->m_uring.peek_cqe()) != 0) {
+			const uint64_t user_data = cqe->user_data;
+			const int result = cqe->res;
+			const uint32_t flags = cqe->flags;
+			void* const ptr = (void*) uintptr_t(user_data & ~uint64_t(uring_mask));
+
+			running->m_uring.cqe_seen();
+
+			switch (user_data & uring_mask) {
+			case uring_accept:
+				this->on_uring_accepted_i(running, (listen_t*) ptr, result, flags);
+				break;
+
+			case uring_recv:
+				this->on_uring_received_i(running, (conn_t*) ptr, result, flags);
+				break;
+
+			case uring_send:
+				this->on_uring_sent_i(running, (conn_t*) ptr, result);
+				break;
+
+			case uring_send_file:
+				this->on_uring_file_i(running, (conn_t*) ptr, result);
+				break;
+
+			case uring_cancel:
+				this->on_uring_cancelled_i(running, (conn_t*) ptr);
+				break;
+
+			case uring_poll: {
+				auto waitable = (const waitable_t*) ptr;
+				fd_t fd;
+				bool exit = false;
+
+				if (waitable->wait_type() == waitable_t::type_signal) {
+					ret = this->on_signalled_i(running, &exit);
+					fd = running->m_signal;
+				} else if (waitable->wait_type() == waitable_t::type_event) {
+					ret = this->on_notified_i(running, &exit);
+					fd = running->m_event;
+				} else {
+					this->on_aio_queue_i(running, &aio_conns);
+					this->on_aio_completed_i(running, &aio_conns);
+					fd = running->m_aio_queue.fd();
+				}
+
+				if (!ret || exit) {
+					return ret;
+				}
+
+				if ((flags & IORING_CQE_F_MORE) == 0) {
+					ret = this->uring_poll_i(running, fd, waitable);
+					if (!ret) {
+						return ret;
+					}
+				}
+
+				break;
+			}
+
+			default:
+				// Should not run here!
+				assert(false);
+				break;
+			}
+		}
+	}
+
+	return ret;
+}
+
+err_t acceptor_t::uring_poll_i(running_t* running, fd_t fd, const waitable_t* waitable) {
+	auto sqe = running->m_uring.get_sqe();
+	if (sqe == 0) {
+		return EBUSY;
+	}
+
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = fd.get();
+	sqe->poll32_events = POLLIN;
+	sqe->len = IORING_POLL_ADD_MULTI;
+	sqe->user_data = uint64_t(uintptr_t(waitable)) | uring_poll;
+
+	return err_t();
+}
+
+err_t acceptor_t::uring_accept_i(running_t* running, listen_t* listen) {
+	auto sqe = running->m_uring.get_sqe();
+	if (sqe == 0) {
+		return EBUSY;
+	}
+
+	sqe->opcode = IORING_OP_ACCEPT;
+	sqe->fd = listen->sock().get();
+	sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+	sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+	sqe->user_data = uint64_t(uintptr_t(listen)) | uring_accept;
+
+	return err_t();
+}
+
+err_t acceptor_t::uring_recv_i(running_t* running, conn_t* conn) {
+	auto sqe = running->m_uring.get_sqe();
+	if (sqe == 0) {
+		return EBUSY;
+	}
+
+	// Linux kernel picks a provided buffer when data arrives,
+	// so idle connections do not hold any buffer.
+	sqe->opcode = IORING_OP_RECV;
+	sqe->fd = conn->sock().get();
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = uring_t::buf_group;
+	sqe->ioprio = IORING_RECV_MULTISHOT;
+	sqe->user_data = uint64_t(uintptr_t(conn)) | uring_recv;
+
+	conn->uring_state().m_receiving = true;
+	conn->uring_state().m_ops++;
+
+	return err_t();
+}
+
+err_t acceptor_t::uring_cancel_recv_i(running_t* running, conn_t* conn) {
+	auto sqe = running->m_uring.get_sqe();
+	if (sqe == 0) {
+		return EBUSY;
+	}
+
+	// Multishot recv is completed with ECANCELED.
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->fd = -1;
+	sqe->addr = uint64_t(uintptr_t(conn)) | uring_recv;
+	sqe->user_data = uint64_t(uintptr_t(conn)) | uring_cancel;
+
+	conn->uring_state().m_ops++;
+
+	return err_t();
+}
+
+void acceptor_t::uring_send_i(running_t* running, conn_t* conn) {
+	auto& state = conn->uring_state();
+
+	if (!state.m_queued && !state.m_closing) {
+		state.m_queued = true;
+		running->m_send_queue.push_back(conn);
+	}
 }
 
-err_t acceptor_t::bind(const std::string& ip, uint16_t port) {
-	err_t ret;
+void acceptor_t::uring_flush_i(running_t* running) {
+	for (conn_t* conn : running->m_send_queue) {
+		auto& state = conn->uring_state();
 
-	if (ip.empty()) {
-		ret = this->bind_ipv4(ipv4_any, port);
-		if (!ret) {
-			return ret;
+		state.m_queued = false;
+
+		// The rest would be sent when the request in flight is completed.
+		if (state.m_closing || state.m_sending) {
+			continue;
 		}
 
-		ret = this->bind_ipv6(ipv6_any, port);
-		if (!ret) {
-			this->m_listens.resize(this->m_listens.size() - 1);
+		// Handler might append data to send_buf() while it's being sent.
+		if (conn->flight_buf().size() == 0 && conn->flight_chain().empty()) {
+			conn->flight_buf().swap(conn->send_buf());
+			conn->flight_chain().swap(conn->send_chain());
 		}
-	} else {
-		if (ip.find(':') == std::string::npos) {
-			ret = this->bind_ipv4(ip, port);
+
+		if (conn->flight_buf().size() == 0 && conn->flight_chain().empty()) {
+			continue;
+		}
+
+		auto sqe = running->m_uring.get_sqe();
+		if (sqe == 0) {
+			this->uring_close_i(running, conn);
+			continue;
+		}
+
+		fd_t file;
+		int64_t offset;
+		size_t size;
+
+		if (conn->flight_chain().front_file(&file, &offset, &size)) {
+			// Wait until the socket is writable, and then call sendfile().
+			sqe->opcode = IORING_OP_POLL_ADD;
+			sqe->fd = conn->sock().get();
+			sqe->poll32_events = POLLOUT;
+			sqe->user_data = uint64_t(uintptr_t(conn)) | uring_send_file;
+
+			state.m_sending = true;
+			state.m_ops++;
+			continue;
+		} else if (conn->flight_chain().empty()) {
+			sqe->opcode = IORING_OP_SEND;
+			sqe->addr = uint64_t(uintptr_t(conn->flight_buf().front()));
+			sqe->len = uint32_t(conn->flight_buf().size());
 		} else {
-			ret = this->bind_ipv6(ip, port);
+			// Segments are gathered by sendmsg, the message lives in conn_t
+			// until the request is completed.
+			std::memset(&state.m_msg, 0, sizeof(state.m_msg));
+			state.m_msg.msg_iov = state.m_iov;
+			state.m_msg.msg_iovlen = conn->flight_chain().fill(
+				conn->flight_buf(), state.m_iov, send_chain_t::max_iov);
+
+			sqe->opcode = IORING_OP_SENDMSG;
+			sqe->addr = uint64_t(uintptr_t(&state.m_msg));
+			sqe->len = 1;
 		}
+
+		sqe->fd = conn->sock().get();
+		sqe->msg_flags = MSG_NOSIGNAL;
+		sqe->user_data = uint64_t(uintptr_t(conn)) | uring_send;
+
+		state.m_sending = true;
+		state.m_ops++;
 	}
 
-	return ret;
+	running->m_send_queue.clear();
 }
 
-err_t acceptor_t::bind_ipv4(const std::string& ip, uint16_t port) {
-	err_t ret;
-	socket_t sd;
-	const std::string& real_ip = ip.empty() ? ipv4_any : ip;
+void acceptor_t::uring_close_i(running_t* running, conn_t* conn) {
+	auto& state = conn->uring_state();
 
-	ret = sd.new_ipv4_nonblock();
-	if (!ret) {
-		goto clean;
-	}
+	if (!state.m_closing) {
+		state.m_closing = true;
+		conn->timer()->cancel();
 
-	ret = sd.bind_ipv4(real_ip, port);
-	if (!ret) {
-		goto clean;
+		if (state.m_queued) {
+			auto& queue = running->m_send_queue;
+			queue.erase(std::remove(queue.begin(), queue.end(), conn), queue.end());
+			state.m_queued = false;
+		}
+
+		// Requests in flight would be completed right away.
+		if (state.m_ops > 0) {
+			::shutdown(conn->sock().get(), SHUT_RDWR);
+		}
 	}
 
-	ret = sd.listen(this->m_config.backlog());
-	if (!ret) {
-		goto clean;
+	if (state.m_ops == 0) {
+		this->gc_conn_i(running, conn, false);
 	}
+}
 
-	this->m_listens.emplace_back(new listen_t(sd, real_ip, port, false));
-	ret.set_ok();
+void acceptor_t::on_uring_accepted_i(running_t* running, listen_t* listen, int result, uint32_t flags) {
+	err_t ret;
+	conn_event_t* const handler = running->m_handler;
 
-clean:
+	if (result >= 0) {
+		socket_t new_sd(result);
 
-	if (!ret) {
-		sd.close();
-	}
+		// Multishot accept does not return peer address,
+		// conn_t gets it by getpeername() only if it's needed.
+		conn_t* const conn = this->new_conn_i(running, new_sd, 0);
 
-	return ret;
-}
+		// Trigger "on_connected" event.
+		conn->last_event_result(handler->on_connected(
+				*conn, this->m_config, *conn, conn->send_buf()));
 
-err_t acceptor_t::bind_ipv6(const std::string& ip, uint16_t port) {
-	err_t ret;
-	socket_t sd;
-	const std::string& real_ip = ip.empty() ? ipv6_any : ip;
+		// If no data to send and disconnect flag is on,
+		// then close connection.
+		if ((conn->last_event_result() & conn_event_t::result_disconnect) != 0
+			&& conn->pending_send_size() == 0) {
+			this->gc_conn_i(running, conn, true);
+		} else {
+			// Add it to used list.
+			running->m_used_list.push_back(conn->link_node());
+			running->m_used_count ++;
 
-	ret = sd.new_ipv6_nonblock();
-	if (!ret) {
-		goto clean;
-	}
+			ret = this->uring_recv_i(running, conn);
+			if (!ret) {
+				this->uring_close_i(running, conn);
+			} else {
+				if (conn->pending_send_size() > 0) {
+					this->uring_send_i(running, conn);
+				}
 
-	ret = sd.bind_ipv6(real_ip, port);
-	if (!ret) {
-		goto clean;
-	}
+				this->arm_timer_i(running, conn);
+			}
+		}
 
-	ret = sd.listen(this->m_config.backlog());
-	if (!ret) {
-		goto clean;
+		running->m_stats->on_listen_wakeup(1);
 	}
 
-	this->m_listens.emplace_back(new listen_t(sd, real_ip, port, true));
-	ret.set_ok();
+	// Multishot accept was terminated (e.g. too many open files), re-arm it.
+	if ((flags & IORING_CQE_F_MORE) == 0 && result != -EBADF && result != -EINVAL) {
+		this->uring_accept_i(running, listen);
+	}
+}
 
-clean:
+void acceptor_t::on_uring_received_i(running_t* running, conn_t* conn, int result, uint32_t flags) {
+	auto& state = conn->uring_state();
 
-	if (!ret) {
-		sd.close();
+	if ((flags & IORING_CQE_F_MORE) == 0) {
+		state.m_receiving = false;
+		state.m_ops--;
 	}
 
-	return ret;
-}
+	if (result > 0) {
+		const auto bid = uint16_t(flags >> IORING_CQE_BUFFER_SHIFT);
 
-err_t acceptor_t::bind(std::initializer_list<std::pair<std::string, uint16_t>> list) {
-	err_t ret;
-	const size_t old_size = this->m_listens.size();
+		// If disconnect flag is on, new data is dropped.
+		if (!state.m_closing
+			&& (conn->last_event_result() & conn_event_t::result_disconnect) == 0) {
+			conn->recv_buf().push_back(running->m_uring.buf(bid), size_t(result));
+		} else {
+			result = 0;
+		}
 
-	for (auto it = list.begin(); it != list.end(); ++it) {
-		ret = this->bind((*it).first.c_str(), (*it).second);
+		running->m_uring.recycle_buf(bid);
 
-		if (!ret) {
-			this->m_listens.resize(old_size);
-			return ret;
+		// More data arrived before previous responses are sent (e.g. client
+		// pipelines requests without reading responses), so stop receiving
+		// until pending data is sent, like EPOLLOUT does in epoll mode.
+		if (result > 0 && !state.m_paused && conn->pending_send_size() > 0) {
+			state.m_paused = true;
+
+			if (state.m_receiving && !this->uring_cancel_recv_i(running, conn)) {
+				this->uring_close_i(running, conn);
+				return;
+			}
+		}
+
+		// Trigger "on_received" event. Data that arrives before multishot
+		// recv is cancelled is kept, it's handled after pending data is sent.
+		if (result > 0 && !state.m_paused && !this->uring_on_received_i(running, conn)) {
+			return;
 		}
+	} else if (result != -ENOBUFS && result != -ECANCELED) {
+		// Client side has closed connection, or an error happened.
+		this->uring_close_i(running, conn);
+		return;
 	}
 
-	return ret;
+	if (state.m_closing) {
+		this->uring_close_i(running, conn);
+		return;
+	}
+
+	// Multishot recv was terminated (e.g. no provided buffer), re-arm it.
+	if (!state.m_receiving && !state.m_paused && !this->uring_recv_i(running, conn)) {
+		this->uring_close_i(running, conn);
+		return;
+	}
+
+	conn->release_bufs();
+	this->arm_timer_i(running, conn);
 }
 
-std::vector<std::pair<std::string, uint16_t>> acceptor_t::binds() const {
-	std::vector<std::pair<std::string, uint16_t>> vt;
+bool acceptor_t::uring_on_received_i(running_t* running, conn_t* conn) {
+	conn->last_event_result(running->m_handler->on_received(
+		*conn, this->m_config, *conn,
+		conn->recv_buf(), conn->send_buf()));
 
-	vt.reserve(this->m_listens.size());
-	for (auto it = this->m_listens.cbegin(); it != this->m_listens.cend(); ++it) {
-		vt.push_back(std::pair<std::string, uint16_t>((*it)->ip(), (*it)->port()));
+	if (conn->pending_send_size() > 0) {
+		this->uring_send_i(running, conn);
+	} else if (conn->last_event_result() & conn_event_t::result_disconnect) {
+		this->uring_close_i(running, conn);
+		return false;
 	}
 
-	return vt;
+	return true;
 }
 
-err_t acceptor_t::run_tcp(conn_event_t* handler) {
-	err_t ret;
-	running_t running(handler);
-	const int events_size = this->m_config.max_epoll_events();
-	struct epoll_event* events = 0;
-	std::set<conn_t*> aio_conns; // Which connection has completed AIO tasks.
-	std::vector<aio_t> aio_completed; // Completed AIO tasks.
-	socket_t new_sd;
-	std::string new_ip;
-	uint16_t new_port;
-	bool new_ipv6;
+void acceptor_t::on_uring_sent_i(running_t* running, conn_t* conn, int result) {
+	conn_event_t* const handler = running->m_handler;
+	auto& state = conn->uring_state();
 
-	assert(handler != 0);
+	state.m_sending = false;
+	state.m_ops--;
 
-	// Create worker processes.
-	if (this->m_config.worker_processes() > 0) {
-		ret = this->m_worker_pool.create(this->m_config.worker_processes());
-		if (!ret) {
-			goto clean;
-		}
+	if (state.m_closing || result < 0) {
+		this->uring_close_i(running, conn);
+		return;
 	}
 
-	// Create epoll handle.
-	running.m_epoll = epoll_create1(EPOLL_CLOEXEC);
-	if (!running.m_epoll.is_open()) {
-		ret.set_current();
-		goto clean;
-	}
+	conn->flight_chain().consume(&conn->flight_buf(), size_t(result));
 
-	// Hook Linux signals.
-	ret = this->signalfd_i(&running.m_signal);
-	if (!ret) {
-		goto clean;
+	if (conn->pending_send_size() == 0
+		&& (conn->last_event_result() & conn_event_t::result_more_data) != 0) {
+		conn->last_event_result(handler->get_more_data(
+				*conn, this->m_config, *conn, conn->send_buf()));
 	}
 
-	// Add signal fd to epoll.
-	ret = this->epoll_set_i(running.m_epoll, running.m_signal.get(),
-		&running.m_waitable_signal, EPOLL_CTL_ADD, EPOLLIN | EPOLLET);
-	if (!ret) {
-		goto clean;
-	}
+	if (conn->pending_send_size() > 0) {
+		this->uring_send_i(running, conn);
+	} else if (conn->last_event_result() & conn_event_t::result_disconnect) {
+		// If all data has been sent and disconnect flag is on,
+		// then close connection.
+		this->uring_close_i(running, conn);
+		return;
+	} else if (state.m_paused) {
+		// All pending data has been sent, handle data received meanwhile
+		// and resume receiving. If the multishot recv is not cancelled yet,
+		// then it's re-armed after that.
+		state.m_paused = false;
+
+		if (conn->recv_buf().size() > 0 && !this->uring_on_received_i(running, conn)) {
+			return;
+		}
 
-	// Add listening sockets.
-	if (this->m_config.worker_processes() == 0 || !this->m_worker_pool.main_process()) {
-		for (auto it = this->m_listens.begin(); it != this->m_listens.end(); ++it) {
-			ret = this->epoll_set_i(running.m_epoll, (*it).get()->sock(), (*it).get(), EPOLL_CTL_ADD, EPOLLIN | EPOLLET);
-			if (!ret) {
-				goto clean;
-			}
+		if (!state.m_receiving && !this->uring_recv_i(running, conn)) {
+			this->uring_close_i(running, conn);
+			return;
 		}
 	}
 
-	events = new struct epoll_event[events_size];
-	while (true) {
-		const int wait_result = epoll_wait(running.m_epoll.get(), events, events_size, -1);
-
-		if (wait_result == -1) {
-			const auto e = err_t::current();
+	conn->release_bufs();
+	this->arm_timer_i(running, conn);
+}
 
-			if (e == EINTR) {
-				continue;
-			} else {
-				ret.set(e);
-				goto clean;
-			}
-		}
+void acceptor_t::on_uring_cancelled_i(running_t* running, conn_t* conn) {
+	auto& state = conn->uring_state();
 
-		for (int i = 0; i < wait_result; ++i) {
-			auto waitable = (const waitable_t*) events[i].data.ptr;
+	state.m_ops--;
 
-			if (waitable->wait_type() == waitable_t::type_signal) {
-				bool exit;
+	if (state.m_closing) {
+		this->uring_close_i(running, conn);
+	}
+}
 
-				ret = this->on_signalled_i(running.m_epoll, running.m_signal, &exit, &aio_conns);
-				if (!ret || exit) {
-					goto clean;
-				}
+void acceptor_t::on_uring_file_i(running_t* running, conn_t* conn, int result) {
+	fd_t file;
+	int64_t offset;
+	size_t size;
 
-				for (conn_t* conn : aio_conns) {
-					bool gc = false;
+	if (result >= 0 && !conn->uring_state().m_closing
+		&& conn->flight_chain().front_file(&file, &offset, &size)) {
+		size_t ok_bytes;
+		const auto ret = conn->sock().sendfile(file, offset, size, &ok_bytes);
 
-					// Popup AIO completed tasks.
-					conn->popup_aio_completed(&aio_completed);
-					if (aio_completed.empty()) {
-						continue;
-					}
+		if (ret.ok()) {
+			result = int(ok_bytes);
+		} else if (ret == EAGAIN || ret == EWOULDBLOCK) {
+			result = 0;
+		} else {
+			result = -ret.code();
+		}
+	}
 
-					// Invoke callback function to handle completed aio tasks.
-					conn->last_event_result(handler->on_aio_completed(
-						*conn, this->m_config, *conn, conn->aio_running_count(),
-						aio_completed, conn->send_buf()));
+	this->on_uring_sent_i(running, conn, result);
+}
 
-					if (conn->pending_send_size() > 0) {
-						this->epoll_set_i(running.m_epoll, conn->sock(), conn, EPOLL_CTL_MOD, EPOLLOUT | EPOLLET);
-					} else if (conn->last_event_result() & conn_event_t::result_disconnect) {
-						gc = true;
-						break;
-					}
+int acceptor_t::on_timers_i(running_t* running) {
+	running->m_timers.advance(utility_t::now_ms(), [this, running](timer_node_t* node) {
+		conn_t* const conn = (conn_t*) node->owner();
 
-					// An error happened or client side closed connection,
-					// we need to garbage collect the conn.
-					if (gc) {
-						this->gc_conn_i(&running, conn, false);
-					}
-				}
+		conn->timer_phase(conn_t::timer_none);
+		running->m_stats->on_timeout();
 
-				// Remove aio-completed conn pointers.
-				aio_conns.clear();
-			} else if (waitable->wait_type() == waitable_t::type_listen) {
-				auto listen = (listen_t*) waitable;
+		if (running->m_uring.is_open()) {
+			this->uring_close_i(running, conn);
+		} else {
+			this->gc_conn_i(running, conn, false);
+		}
+	});
 
-				while (true) {
-					conn_t* conn;
-					bool gc = false;
+	return running->m_timers.next_timeout_ms();
+}
 
-					// Accept new connection.
-					ret = listen->sock().accept(&new_sd, &new_ip, &new_port, &new_ipv6);
-					if (!ret) {
-						if (ret == EAGAIN || ret == EWOULDBLOCK) {
-							break;
-						} else {
-							goto clean;
-						}
-					}
+void acceptor_t::arm_timer_i(running_t* running, conn_t* conn) {
+	int phase;
+	int timeout_ms;
 
-					// Set non-block flag.
-					ret = new_sd.nonblock(true);
-					if (!ret) {
-						new_sd.close();
-						continue;
-					}
+	assert(running != 0);
+	assert(conn != 0);
 
-					if (running.m_free_count > 0) {
-						// Pop an free conn object from free list.
-						running.m_free_count--;
-						conn = running.m_free_list.pop_front()->get();
-						conn->sock(new_sd);
-						conn->ip(new_ip);
-						conn->port(new_port);
-						conn->ipv6(new_ipv6);
-					} else {
-						// Create a new conn object.
-						conn = new conn_t(new_sd, new_ip, new_port, new_ipv6);
-					}
+	if (conn->uring_state().m_closing) {
+		return;
+	}
 
-					do {
-						// Trigger "on_connected" event.
-						conn->last_event_result(handler->on_connected(
-								*conn, this->m_config, *conn, conn->send_buf()));
-
-						// If no data to send and disconnect flag is on,
-						// then close connection.
-						if ((conn->last_event_result() & conn_event_t::result_disconnect) != 0
-							&& conn->pending_send_size() == 0) {
-							gc = true;
-							break;
-						}
-
-						// If there are data to send, then send it right now.
-						if (conn->pending_send_size() > 0) {
-							ret = this->loop_send_i(handler, conn);
-							if (!ret) {
-								gc = true;
-								break;
-							}
-						}
-
-						// Add it to epoll list.
-						ret = this->epoll_set_i(running.m_epoll, conn->sock(), conn, EPOLL_CTL_ADD,
-								conn->pending_send_size() == 0 ?
-								(EPOLLIN | EPOLLET) : (EPOLLOUT | EPOLLET));
-
-						if (!ret) {
-							gc = true;
-							break;
-						}
-					} while (0);
-
-					if (gc) {
-						this->gc_conn_i(&running, conn, true);
-					} else {
-						// Add it to used list.
-						running.m_used_list.push_back(conn->link_node());
-						running.m_used_count ++;
-					}
-				}
-			} else if (waitable->wait_type() == waitable_t::type_conn) {
-				auto conn = (conn_t*) waitable;
-				bool gc = false;
-
-				do {
-					if (events[i].events & EPOLLIN) {
-						size_t new_recv_size;
-						bool peer_closed;
-
-						// New data is ready to read.
-						ret = conn->recv(&new_recv_size, &peer_closed);
-						if (!ret) {
-							gc = true;
-							break;
-						}
-
-						// Trigger "on_received" event.
-						if (new_recv_size > 0) {
-							conn->last_event_result(handler->on_received(
-								*conn, this->m_config, *conn,
-								conn->recv_buf(), conn->send_buf()));
-						}
-
-						// Client side has closed connection.
-						if (peer_closed) {
-							gc = true;
-							break;
-						}
-
-						if (conn->pending_send_size() > 0) {
-							this->epoll_set_i(running.m_epoll, conn->sock(), conn, EPOLL_CTL_MOD, EPOLLOUT | EPOLLET);
-						} else if (conn->last_event_result() & conn_event_t::result_disconnect) {
-							gc = true;
-							break;
-						}
-					} else if (events[i].events & EPOLLOUT) {
-						ret = this->loop_send_i(handler, conn);
-						if (!ret) {
-							gc = true;
-							break;
-						}
-
-						if (conn->pending_send_size() == 0) {
-							// If all data has been sent and disconnect flag is on,
-							// then close connection.
-							if (conn->last_event_result() & conn_event_t::result_disconnect) {
-								gc = true;
-								break;
-							}
-
-							// All data has been sent, switch to receive data mode.
-							this->epoll_set_i(running.m_epoll, conn->sock(), conn, EPOLL_CTL_MOD, EPOLLIN | EPOLLET);
-						}
-					}
-				} while (0);
+	if (conn->aio_running_count() > 0) {
+		// Waiting for AIO tasks, not for the client.
+		phase = conn_t::timer_none;
+		timeout_ms = 0;
+	} else if (conn->pending_send_size() > 0 || conn->recv_buf().size() == 0) {
+		phase = conn_t::timer_idle;
+		timeout_ms = this->m_config.keep_alive_timeout();
+	} else if (conn->last_event_result() & conn_event_t::result_wait_body) {
+		phase = conn_t::timer_body;
+		timeout_ms = this->m_config.body_timeout();
+	} else {
+		phase = conn_t::timer_header;
+		timeout_ms = this->m_config.header_timeout();
+	}
 
-				// An error happened or client side closed connection,
-				// we need to garbage collect the conn.
-				if (gc) {
-					this->gc_conn_i(&running, conn, false);
-				}
-			} else {
-				// Should not run here!
-				assert(false);
-			}
-		}
+	if (timeout_ms == 0) {
+		conn->timer()->cancel();
+		conn->timer_phase(conn_t::timer_none);
+		return;
 	}
 
-	ret.set_ok();
+	// Header deadline is not extended by new data of the same request,
+	// but a pipelined request gets its own deadline. The flag is cleared,
+	// so that the deadline is restarted once for each request boundary.
+	if (conn->last_event_result() & conn_event_t::result_request_done) {
+		conn->last_event_result(conn->last_event_result()
+			& ~uint32_t(conn_event_t::result_request_done));
+	} else if (phase == conn_t::timer_header
+		&& conn->timer_phase() == conn_t::timer_header
+		&& conn->timer()->active()) {
+		return;
+	}
 
-clean:
+	conn->timer_phase(phase);
+	running->m_timers.start(conn->timer(), uint64_t(timeout_ms));
+}
 
-	// Trigger "on_disconnected" event for each existing connection.
-	do {
-		const config_t* cfg = &this->m_config;
-		running.m_used_list.for_each([handler, cfg](conn_t* c) {
-			handler->on_disconnected(*c, *cfg, *c);
-			delete c;
-		});
-	} while (0);
+bool acceptor_t::try_send_i(running_t* running, conn_t* conn) {
+	assert(running != 0);
+	assert(conn != 0);
 
-	running.m_aio_wait_list.clear();
-	running.m_free_list.clear();
+	if (conn->pending_send_size() > 0 && conn->writable()) {
+		if (!this->loop_send_i(running->m_handler, conn)) {
+			return false;
+		}
 
-	if (events != 0) {
-		delete[] events;
-		events = 0;
+		// Socket buffer is full, wait for next EPOLLOUT.
+		if (conn->pending_send_size() > 0) {
+			conn->writable(false);
+		}
 	}
 
-	running.m_epoll.close();
-	running.m_signal.close();
-
-	// Kill all worker process.
-	this->m_worker_pool.kill_all();
+	// If all data has been sent and disconnect flag is on,
+	// then close connection.
+	if (conn->pending_send_size() == 0
+		&& (conn->last_event_result() & conn_event_t::result_disconnect) != 0) {
+		return false;
+	}
 
-	return ret;
+	return true;
 }
 
 err_t acceptor_t::run_tcp(const conn_event_adapter_t::on_received_t& recv) {
@@ -480,6 +1471,14 @@ err_t acceptor_t::stop() {
 	return ret;
 }
 
+uint32_t acceptor_t::listen_events_i() const {
+	if (this->m_config.enabled(config_t::exclusive_accept)) {
+		return EPOLLIN | EPOLLEXCLUSIVE;
+	} else {
+		return EPOLLIN | EPOLLET;
+	}
+}
+
 err_t acceptor_t::epoll_set_i(fd_t epoll, socket_t sock,
 	const waitable_t* waitable, int op, uint32_t events) {
 	assert(epoll.is_open());
@@ -501,17 +1500,69 @@ err_t acceptor_t::epoll_del_i(fd_t epoll, socket_t sock) {
 	return epoll_ctl(epoll.get(), EPOLL_CTL_DEL, sock.get(), 0);
 }
 
-void acceptor_t::add_free_conn_i(link_t<conn_t>* free_list, int* free_count, conn_t* conn) {
+void acceptor_t::add_free_conn_i(running_t* running, conn_t* conn) {
 	assert(!conn->link_node()->linked());
 
-	if (*free_count < this->m_config.max_free_connection()) {
-		free_list->push_front(conn->link_node());
-		++ *free_count;
+	// Pending events of the batch might still point to it.
+	if (running->m_batching) {
+		running->m_closed_list.push_back(conn->link_node());
+		return;
+	}
+
+	// Preallocated objects are always kept.
+	if (running->m_free_count < this->m_config.max_free_connection()
+		|| running->in_slab(conn)) {
+		running->m_free_list.push_front(conn->link_node());
+		++ running->m_free_count;
+	} else {
+		delete conn;
+	}
+}
+
+void acceptor_t::free_closed_i(running_t* running) {
+	running->m_batching = false;
+
+	while (!running->m_closed_list.empty()) {
+		conn_t* const conn = running->m_closed_list.next()->get();
+		conn->link_node()->unlink();
+		this->add_free_conn_i(running, conn);
+	}
+}
+
+void acceptor_t::delete_conn_i(running_t* running, conn_t* conn) {
+	if (running->in_slab(conn)) {
+		// Memory is freed by close_running_i().
+		conn->~conn_t();
 	} else {
 		delete conn;
 	}
 }
 
+void acceptor_t::prealloc_conns_i(running_t* running) {
+	const int count = this->m_config.prealloc_connections();
+
+	if (count <= 0 || running->m_slab != 0) {
+		return;
+	}
+
+	// Objects are contiguous, and constructors touch all pages now
+	// instead of on the first burst of connections.
+	running->m_slab = (char*) ::operator new(sizeof(conn_t) * size_t(count));
+	running->m_slab_count = count;
+
+	for (int i = 0; i < count; ++i) {
+		conn_t* const conn = new (running->m_slab + sizeof(conn_t) * i)
+			conn_t(socket_t(), 0);
+
+		conn->pool(&running->m_buf_pool);
+		conn->ctx(running->m_handler->new_ctx());
+
+		// Keep the order, so that accepted connections are adjacent.
+		running->m_free_list.push_back(conn->link_node());
+		running->m_free_count++;
+	}
+}
+
 err_t acceptor_t::loop_send_i(conn_event_t* handler, conn_t* conn) {
 	err_t ret;
 
@@ -541,8 +1592,7 @@ err_t acceptor_t::loop_send_i(conn_event_t* handler, conn_t* conn) {
 	return ret;
 }
 
-err_t acceptor_t::on_signalled_i(
-	fd_t epoll, fd_t signal_fd, bool* exit, std::set<conn_t*>* aio_conns) {
+err_t acceptor_t::on_signalled_i(running_t* running, bool* exit) {
 
 	err_t ret;
 	size_t new_read_size;
@@ -550,19 +1600,18 @@ err_t acceptor_t::on_signalled_i(
 	int dead_workers = 0;
 	const struct signalfd_siginfo* ptr;
 
+	assert(running != 0);
 	assert(exit != 0);
-	assert(aio_conns != 0);
 
 	// Clear content.
 	*exit = false;
-	aio_conns->clear();
 
 	// Read signal info.
 	//
 	// Note that we do NOT check return code immediately
 	// because some signal info might have already been gotten
-	// (e.g. AIO signals) that need to handle right away.
-	ret = signal_fd.read_nonblock(&this->m_signal_buf, &new_read_size, &eof);
+	// that need to handle right away.
+	ret = running->m_signal.read_nonblock(&this->m_signal_buf, &new_read_size, &eof);
 
 	ptr = (const struct signalfd_siginfo*) this->m_signal_buf.front();
 	const size_t times = this->m_signal_buf.size() / sizeof(struct signalfd_siginfo);
@@ -572,12 +1621,6 @@ err_t acceptor_t::on_signalled_i(
 			*exit = true;
 		} else if (ptr[i].ssi_signo == SIGCHLD) {
 			dead_workers += this->on_worker_terminated_i();
-		} else if (int(ptr[i].ssi_signo) == conn_t::aio_signal_id) {
-			auto aio_node = (conn_t::aio_node_t*) ptr[i].ssi_ptr;
-			if (aio_node != 0) {
-				aio_node->m_conn->on_aio_completed_i(aio_node);
-				aio_conns->insert(aio_node->m_conn);
-			}
 		} else {
 			// Should not run here!
 			assert(false);
@@ -589,7 +1632,7 @@ err_t acceptor_t::on_signalled_i(
 
 	// Restart dead worker processes.
 	if (dead_workers > 0) {
-		const err_t ret_tmp = this->restart_worker_i(epoll, dead_workers);
+		const err_t ret_tmp = this->restart_worker_i(running, dead_workers);
 		if (!ret_tmp && ret.ok()) {
 			ret = ret_tmp;
 		}
@@ -598,6 +1641,30 @@ err_t acceptor_t::on_signalled_i(
 	return ret;
 }
 
+err_t acceptor_t::on_notified_i(running_t* running, bool* exit) {
+	uint64_t value;
+
+	assert(running != 0);
+	assert(exit != 0);
+
+	// Clear content.
+	*exit = false;
+
+	// Reset event fd counter.
+	if (::read(running->m_event.get(), &value, sizeof(value)) == -1) {
+		const auto e = err_t::current();
+		if (e != EAGAIN && e != EWOULDBLOCK) {
+			return e;
+		}
+	}
+
+	if (running->m_stop) {
+		*exit = true;
+	}
+
+	return err_t();
+}
+
 int acceptor_t::on_worker_terminated_i() {
 	int dead_workers = 0;
 
@@ -617,9 +1684,11 @@ int acceptor_t::on_worker_terminated_i() {
 	return dead_workers;
 }
 
-err_t acceptor_t::restart_worker_i(fd_t epoll, int dead_workers) {
+err_t acceptor_t::restart_worker_i(running_t* running, int dead_workers) {
 	err_t ret;
 
+	assert(running != 0);
+
 	// Re-start worker processes if they died.
 	if (dead_workers <= 0
 		|| !this->m_worker_pool.main_process()
@@ -631,12 +1700,31 @@ err_t acceptor_t::restart_worker_i(fd_t epoll, int dead_workers) {
 	this->m_worker_pool.create(dead_workers);
 
 	if (!this->m_worker_pool.main_process()) {
-		// Add listening sockets.
-		for (auto it = this->m_listens.begin(); it != this->m_listens.end(); ++it) {
-			ret = this->epoll_set_i(epoll, (*it).get()->sock(), (*it).get(), EPOLL_CTL_ADD, EPOLLIN | EPOLLET);
-			if (!ret) {
-				break;
-			}
+		// The epoll handle is shared with main process after fork(),
+		// so the new worker process needs its own one.
+		running->m_epoll.close();
+		running->m_epoll = epoll_create1(EPOLL_CLOEXEC);
+		if (!running->m_epoll.is_open()) {
+			return err_t::current();
+		}
+
+		ret = this->epoll_set_i(running->m_epoll, running->m_signal.get(),
+			&running->m_waitable_signal, EPOLL_CTL_ADD, EPOLLIN | EPOLLET);
+		if (!ret) {
+			return ret;
+		}
+
+		ret = this->epoll_set_i(running->m_epoll, running->m_aio_queue.fd().get(),
+			&running->m_aio_queue, EPOLL_CTL_ADD, EPOLLIN | EPOLLET);
+		if (!ret) {
+			return ret;
+		}
+
+		// Add listening sockets, or create worker threads to do it.
+		if (this->m_config.worker_threads() > 0) {
+			ret = this->start_threads_i(running->m_handler);
+		} else {
+			ret = this->add_listens_i(running);
 		}
 	}
 
@@ -647,6 +1735,13 @@ void acceptor_t::gc_conn_i(running_t* running, conn_t* conn, bool new_conn) {
 	assert(running != 0);
 	assert(conn != 0);
 
+	// The object might be deleted, so remove it from ready list.
+	if (conn->ready_state()) {
+		auto& list = running->m_ready_list;
+		list.erase(std::remove(list.begin(), list.end(), conn), list.end());
+		conn->ready_state(false);
+	}
+
 	if (new_conn) {
 		// Trigger "on_disconnected" event.
 		running->m_handler->on_disconnected(*conn, this->m_config, *conn);
@@ -655,7 +1750,7 @@ void acceptor_t::gc_conn_i(running_t* running, conn_t* conn, bool new_conn) {
 		conn->close();
 
 		// Put it to free list.
-		this->add_free_conn_i(&running->m_free_list, &running->m_free_count, conn);
+		this->add_free_conn_i(running, conn);
 	} else if (conn->aio_wait_state()) {
 		if (conn->aio_running_count() == 0) {
 			// If there is no any running AIO tasks,
@@ -668,7 +1763,7 @@ void acceptor_t::gc_conn_i(running_t* running, conn_t* conn, bool new_conn) {
 			conn->close();
 
 			// Put it to free list.
-			this->add_free_conn_i(&running->m_free_list, &running->m_free_count, conn);
+			this->add_free_conn_i(running, conn);
 		}
 	} else if (conn->aio_running_count() > 0) {
 		// Trigger "on_disconnected" event.
@@ -697,7 +1792,7 @@ void acceptor_t::gc_conn_i(running_t* running, conn_t* conn, bool new_conn) {
 		conn->close();
 
 		// Put it to free list.
-		this->add_free_conn_i(&running->m_free_list, &running->m_free_count, conn);
+		this->add_free_conn_i(running, conn);
 	}
 }
 
@@ -712,7 +1807,6 @@ err_t acceptor_t::signalfd_i(fd_t* fd) {
 	sigaddset(&signal_mask, SIGTERM);
 	sigaddset(&signal_mask, SIGINT);
 	sigaddset(&signal_mask, SIGCHLD);
-	sigaddset(&signal_mask, conn_t::aio_signal_id);
 
 	/* Block the signals that we handle using signalfd(), so they don't
 	 * cause signal handlers or default signal actions to execute. */
@@ -7,7 +7,9 @@
 #pragma once
 
 #include "c11httpd/pre__.h"
+#include "c11httpd/aio_pool.h"
 #include "c11httpd/buf.h"
+#include "c11httpd/buf_pool.h"
 #include "c11httpd/config.h"
 #include "c11httpd/conn.h"
 #include "c11httpd/conn_event.h"
@@ -19,11 +21,16 @@
 #include "c11httpd/worker_pool.h"
 #include "c11httpd/rest_ctrl.h"
 #include "c11httpd/socket.h"
+#include "c11httpd/stats.h"
+#include "c11httpd/timer_wheel.h"
+#include "c11httpd/uring.h"
+#include <atomic>
 #include <functional>
 #include <initializer_list>
 #include <memory>
 #include <set>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -41,21 +48,88 @@ namespace c11httpd {
 class acceptor_t {
 private:
 	// Service running information.
+	//
+	// Each event loop (main thread, or worker thread) has its own object,
+	// so worker threads do not share anything on the hot path.
 	struct running_t {
 		running_t(conn_event_t* handler)
 			: m_waitable_signal(waitable_t::type_signal),
+			  m_waitable_event(waitable_t::type_event),
 			  m_handler(handler) {
 		}
 
 		fd_t m_epoll;
 		fd_t m_signal;
+
+		// Event fd, used by main thread to notify worker threads to quit.
+		fd_t m_event;
+		std::atomic<bool> m_stop{false};
+
+		// Completed AIO tasks of connections of this event loop.
+		aio_queue_t m_aio_queue;
+
+		// Memory of connection buffers. It's declared before any
+		// connection list, so it's destroyed after connections.
+		buf_pool_t m_buf_pool;
+
+		// Listening sockets owned by this event loop (SO_REUSEPORT mode).
+		std::vector<std::unique_ptr<listen_t>> m_listens;
+
+		// Listening sockets that this event loop accepts connections from.
+		std::vector<listen_t*> m_accepts;
+
+		// This event loop handles connections (add_listens_i() was called).
+		bool m_serving = false;
+
+		// io_uring engine (config_t::engine_uring).
+		uring_t m_uring;
+
+		// Connections that used up their read budget (epoll engine).
+		std::vector<conn_t*> m_ready_list;
+
+		// Edge-triggered listening sockets that reached max_accept_batch(),
+		// they still have connections in backlog (epoll engine).
+		std::vector<listen_t*> m_accept_list;
+
+		// Spill buffer of conn_t::recv(), whose size is the read budget.
+		buf_t m_spill;
+
+		// Connections that have data to send. Sending requests are
+		// submitted in one batch after all completion entries are handled.
+		std::vector<conn_t*> m_send_queue;
+
+		// Timeouts of connections of this event loop.
+		timer_wheel_t m_timers;
+
+		// Preallocated connection objects, they are never deleted
+		// until the event loop is closed.
+		char* m_slab = 0;
+		int m_slab_count = 0;
+
+		bool in_slab(const conn_t* conn) const {
+			return (const char*) conn >= this->m_slab
+				&& (const char*) conn < this->m_slab + sizeof(conn_t) * this->m_slab_count;
+		}
+
 		link_t<conn_t> m_used_list;
 		link_t<conn_t> m_aio_wait_list;
 		link_t<conn_t> m_free_list;
+
+		// Connections closed while handling a batch of epoll events.
+		// They are put to free list after the batch, so that a later
+		// event of the same batch never touches a deleted (or re-used) object.
+		link_t<conn_t> m_closed_list;
+		bool m_batching = false;
+
 		int m_used_count = 0;
 		int m_aio_wait_count = 0;
 		int m_free_count = 0;
+		std::vector<aio_t> m_aio_completed;
+		stats_t m_own_stats;
+		stats_t* m_stats = 0;
+		err_t m_result;
 		const waitable_t m_waitable_signal;
+		const waitable_t m_waitable_event;
 		conn_event_t* const m_handler;
 	};
 
@@ -142,6 +216,14 @@ public:
 		this->m_config = cfg;
 	}
 
+	// Get statistics of the current process.
+	//
+	// Note that if there are worker threads, their statistics
+	// are added when the service stops.
+	const stats_t& stats() const {
+		return this->m_stats;
+	}
+
 	// Stop the service.
 	//
 	// Note that this function could be called from another thread
@@ -149,11 +231,125 @@ public:
 	err_t stop();
 
 private:
+	// io_uring request types, saved in the lowest bits of "user_data"
+	// (objects are at least 8-byte aligned).
+	enum {
+		uring_accept = 0,
+		uring_recv = 1,
+		uring_send = 2,
+		uring_poll = 3,
+		uring_send_file = 4,
+		uring_cancel = 5,
+		uring_mask = 7
+	};
+
 	// Remove copy constructor, and operator=().
 	acceptor_t(const acceptor_t&) = delete;
 	acceptor_t& operator=(const acceptor_t&) = delete;
 
 private:
+	// Create a listening socket.
+	err_t listen_i(const std::string& ip, uint16_t port, bool ipv6, socket_t* sd);
+
+	// Create epoll handle, and add Linux signals (main thread)
+	// or event fd (worker thread) to it.
+	err_t open_running_i(running_t* running, bool main_thread);
+
+	// Close handles and connections of an event loop.
+	void close_running_i(running_t* running);
+
+	// Add listening sockets to an event loop.
+	err_t add_listens_i(running_t* running);
+
+	// Create worker threads, each of them runs its own event loop.
+	err_t start_threads_i(conn_event_t* handler);
+
+	// Notify worker threads to quit and wait for them.
+	void stop_threads_i();
+
+	// Wake up a worker thread.
+	void notify_i(running_t* running);
+
+	// Run the event loop of configured engine.
+	err_t run_loop_i(running_t* running);
+
+	// Event loop (epoll).
+	err_t loop_i(running_t* running);
+
+	// Event loop (io_uring).
+	err_t loop_uring_i(running_t* running);
+
+	// Get completed AIO tasks from aio_queue_t.
+	void on_aio_queue_i(running_t* running, std::set<conn_t*>* aio_conns);
+
+	// Handle connections that have completed AIO tasks.
+	void on_aio_completed_i(running_t* running, std::set<conn_t*>* aio_conns);
+
+	// Accept new connections.
+	err_t on_accept_i(running_t* running, listen_t* listen);
+
+	// Handle connection epoll events.
+	void on_conn_event_i(running_t* running, conn_t* conn, uint32_t events);
+
+	// Continue to read connections in ready list,
+	// and accept connections of listening sockets in accept list.
+	err_t on_ready_i(running_t* running);
+
+	// Close timed-out connections.
+	//
+	// Return how many milliseconds until the next timer expires (-1 means no timer).
+	int on_timers_i(running_t* running);
+
+	// Start (or stop) the timeout timer of a connection based on its state,
+	// it's called after each event of the connection.
+	void arm_timer_i(running_t* running, conn_t* conn);
+
+	// Send pending data right away if socket is writable.
+	//
+	// Return false if the connection should be garbage-collected.
+	bool try_send_i(running_t* running, conn_t* conn);
+
+	// Get a connection object from free list, or create a new one.
+	//
+	// If "addr" is null, peer address is got when it's needed.
+	conn_t* new_conn_i(running_t* running, socket_t sd,
+		const struct sockaddr_storage* addr);
+
+	// Add io_uring requests.
+	err_t uring_poll_i(running_t* running, fd_t fd, const waitable_t* waitable);
+	err_t uring_accept_i(running_t* running, listen_t* listen);
+	err_t uring_recv_i(running_t* running, conn_t* conn);
+	err_t uring_cancel_recv_i(running_t* running, conn_t* conn);
+
+	// Add a connection to the batch of sending requests.
+	void uring_send_i(running_t* running, conn_t* conn);
+
+	// Submit sending requests in the batch.
+	void uring_flush_i(running_t* running);
+
+	// Trigger "on_received" event in io_uring mode, and send the response.
+	// Return false if the connection is being closed.
+	bool uring_on_received_i(running_t* running, conn_t* conn);
+
+	// Close a connection in io_uring mode.
+	//
+	// The connection is garbage-collected after all requests
+	// in flight are completed.
+	void uring_close_i(running_t* running, conn_t* conn);
+
+	// Handle io_uring completion entries.
+	void on_uring_accepted_i(running_t* running, listen_t* listen, int result, uint32_t flags);
+	void on_uring_received_i(running_t* running, conn_t* conn, int result, uint32_t flags);
+	void on_uring_sent_i(running_t* running, conn_t* conn, int result);
+	void on_uring_cancelled_i(running_t* running, conn_t* conn);
+
+	// Socket is writable, send the file segment at the beginning of
+	// flight chain by sendfile() (io_uring has no such operation).
+	void on_uring_file_i(running_t* running, conn_t* conn, int result);
+
+	// Get epoll events of listening sockets.
+	uint32_t listen_events_i() const;
+
 	// Add/update epoll item.
 	err_t epoll_set_i(fd_t epoll, socket_t sock,
 		const waitable_t* waitable, int op, uint32_t events);
@@ -162,19 +358,31 @@ private:
 	err_t epoll_del_i(fd_t epoll, socket_t sock);
 
 	// Add a free connection object.
-	void add_free_conn_i(link_t<conn_t>* free_list, int* free_count, conn_t* conn);
+	void add_free_conn_i(running_t* running, conn_t* conn);
+
+	// Put connections closed by the batch of events to free list.
+	void free_closed_i(running_t* running);
+
+	// Destroy a connection object.
+	void delete_conn_i(running_t* running, conn_t* conn);
+
+	// Preallocate connection objects (config_t::prealloc_connections()).
+	void prealloc_conns_i(running_t* running);
 
 	// Send data until send_buf is full.
 	err_t loop_send_i(conn_event_t* handler, conn_t* conn);
 
 	// Linux signal received.
-	err_t on_signalled_i(fd_t epoll, fd_t signal_fd, bool* exit, std::set<conn_t*>* aio_conns);
+	err_t on_signalled_i(running_t* running, bool* exit);
+
+	// Worker thread was notified by main thread.
+	err_t on_notified_i(running_t* running, bool* exit);
 
 	// Return number of terminated worker processes.
 	int on_worker_terminated_i();
 
 	// Restart terminated worker processes.
-	err_t restart_worker_i(fd_t epoll, int dead_workers);
+	err_t restart_worker_i(running_t* running, int dead_workers);
 
 	// Garbage-collect a connection.
 	void gc_conn_i(running_t* running, conn_t* conn, bool new_conn);
@@ -185,8 +393,12 @@ private:
 private:
 	std::vector<std::unique_ptr<listen_t>> m_listens;
 	worker_pool_t m_worker_pool;
+	aio_pool_t m_aio_pool;
 	config_t m_config;
+	stats_t m_stats;
 	buf_t m_signal_buf;
+	std::vector<std::unique_ptr<running_t>> m_thread_runnings;
+	std::vector<std::thread> m_threads;
 };
 
 
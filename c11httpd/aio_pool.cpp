@@ -0,0 +1,218 @@
+/**
+ * AIO thread pool.
+ *
+ * Copyright (c) 2015 Alex Jin (toalexjin@hotmail.com)
+ */
+
+#include "c11httpd/aio_pool.h"
+#include <cerrno>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+
+namespace c11httpd {
+
+
+err_t aio_queue_t::open() {
+	assert(!this->m_event.is_open());
+
+	this->m_event = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (!this->m_event.is_open()) {
+		return err_t::current();
+	}
+
+	return err_t();
+}
+
+void aio_queue_t::close() {
+	this->m_event.close();
+	this->m_head = nullptr;
+}
+
+void aio_queue_t::push(aio_node_t* node) {
+	assert(node != 0);
+
+	aio_node_t* head = this->m_head.load(std::memory_order_relaxed);
+
+	do {
+		node->m_next = head;
+	} while (!this->m_head.compare_exchange_weak(head, node,
+		std::memory_order_release, std::memory_order_relaxed));
+
+	// The event loop is woken up only once for a burst of completions.
+	if (head == 0) {
+		const uint64_t value = 1;
+		const auto result = ::write(this->m_event.get(), &value, sizeof(value));
+		(void) result;
+	}
+}
+
+aio_node_t* aio_queue_t::pop_all() {
+	uint64_t value;
+
+	// Reset event fd counter BEFORE taking tasks, otherwise a task pushed
+	// in between would not wake up the event loop.
+	const auto result = ::read(this->m_event.get(), &value, sizeof(value));
+	(void) result;
+
+	aio_node_t* node = this->m_head.exchange(nullptr, std::memory_order_acquire);
+	aio_node_t* list = 0;
+
+	// Reverse the list, so that tasks are in completion order.
+	while (node != 0) {
+		aio_node_t* const next = node->m_next;
+		node->m_next = list;
+		list = node;
+		node = next;
+	}
+
+	return list;
+}
+
+err_t aio_pool_t::submit(aio_node_t* node) {
+	assert(node != 0);
+	assert(node->m_queue != 0);
+
+	std::lock_guard<std::mutex> lock(this->m_mutex);
+
+	if (this->m_stop) {
+		return ECANCELED;
+	}
+
+	if (this->m_threads.empty()) {
+		for (int i = 0; i < this->m_thread_count; ++i) {
+			this->m_threads.emplace_back([this]() {
+				this->run_i();
+			});
+		}
+	}
+
+	node->m_next = 0;
+	if (this->m_last == 0) {
+		this->m_first = node;
+	} else {
+		this->m_last->m_next = node;
+	}
+
+	this->m_last = node;
+	this->m_cond.notify_one();
+
+	return err_t();
+}
+
+void aio_pool_t::cancel(fd_t fd) {
+	aio_node_t* cancelled = 0;
+
+	do {
+		std::lock_guard<std::mutex> lock(this->m_mutex);
+		aio_node_t* prev = 0;
+		aio_node_t* node = this->m_first;
+
+		while (node != 0) {
+			aio_node_t* const next = node->m_next;
+
+			if (node->m_fd.get() == fd.get()) {
+				if (prev == 0) {
+					this->m_first = next;
+				} else {
+					prev->m_next = next;
+				}
+
+				if (this->m_last == node) {
+					this->m_last = prev;
+				}
+
+				node->m_next = cancelled;
+				cancelled = node;
+			} else {
+				prev = node;
+			}
+
+			node = next;
+		}
+	} while (0);
+
+	while (cancelled != 0) {
+		aio_node_t* const next = cancelled->m_next;
+
+		cancelled->m_error = ECANCELED;
+		cancelled->m_ok_bytes = 0;
+		cancelled->m_queue->push(cancelled);
+		cancelled = next;
+	}
+}
+
+void aio_pool_t::start() {
+	std::lock_guard<std::mutex> lock(this->m_mutex);
+
+	assert(this->m_threads.empty());
+	this->m_stop = false;
+}
+
+void aio_pool_t::stop() {
+	do {
+		std::lock_guard<std::mutex> lock(this->m_mutex);
+		this->m_stop = true;
+		this->m_cond.notify_all();
+	} while (0);
+
+	for (auto it = this->m_threads.begin(); it != this->m_threads.end(); ++it) {
+		(*it).join();
+	}
+
+	this->m_threads.clear();
+	this->m_first = 0;
+	this->m_last = 0;
+}
+
+void aio_pool_t::run_i() {
+	while (true) {
+		aio_node_t* node;
+
+		do {
+			std::unique_lock<std::mutex> lock(this->m_mutex);
+
+			while (!this->m_stop && this->m_first == 0) {
+				this->m_cond.wait(lock);
+			}
+
+			if (this->m_stop) {
+				return;
+			}
+
+			node = this->m_first;
+			this->m_first = node->m_next;
+			if (this->m_first == 0) {
+				this->m_last = 0;
+			}
+		} while (0);
+
+		execute_i(node);
+		node->m_queue->push(node);
+	}
+}
+
+void aio_pool_t::execute_i(aio_node_t* node) {
+	ssize_t result;
+
+	do {
+		if (node->m_write) {
+			result = ::pwrite(node->m_fd.get(), node->m_buf, node->m_size, node->m_offset);
+		} else {
+			result = ::pread(node->m_fd.get(), node->m_buf, node->m_size, node->m_offset);
+		}
+	} while (result == -1 && errno == EINTR);
+
+	if (result == -1) {
+		node->m_error = errno;
+		node->m_ok_bytes = 0;
+	} else {
+		node->m_error = 0;
+		node->m_ok_bytes = size_t(result);
+	}
+}
+
+
+} // namespace c11httpd.
+
+
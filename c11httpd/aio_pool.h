@@ -0,0 +1,196 @@
+/**
+ * AIO thread pool.
+ *
+ * Copyright (c) 2015 Alex Jin (toalexjin@hotmail.com)
+ */
+
+#pragma once
+
+#include "c11httpd/pre__.h"
+#include "c11httpd/conn_session.h"
+#include "c11httpd/err.h"
+#include "c11httpd/fd.h"
+#include "c11httpd/link.h"
+#include "c11httpd/waitable.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace c11httpd {
+
+
+class conn_t;
+class aio_queue_t;
+
+
+// AIO task.
+//
+// An event loop creates the task, an I/O thread of aio_pool_t does the
+// file operation, then the task is pushed to aio_queue_t of the event loop.
+class aio_node_t {
+public:
+	explicit aio_node_t(conn_t* conn)
+		: m_link(uintptr_t(&this->m_link) - uintptr_t(this)) {
+		this->m_next = 0;
+		this->m_conn = conn;
+		this->m_queue = 0;
+		this->m_write = false;
+		this->m_offset = 0;
+		this->m_buf = 0;
+		this->m_size = 0;
+		this->m_id = 0;
+		this->m_error = 0;
+		this->m_ok_bytes = 0;
+	}
+
+	aio_node_t(const aio_node_t&) = delete;
+	aio_node_t& operator=(const aio_node_t&) = delete;
+
+	void to_pub(aio_t* pub) const {
+		assert(pub != 0);
+
+		pub->m_id = this->m_id;
+		pub->m_error = this->m_error;
+		pub->m_fd = this->m_fd;
+		pub->m_offset = this->m_offset;
+		pub->m_buf = this->m_buf;
+		pub->m_size = this->m_size;
+		pub->m_ok_bytes = this->m_ok_bytes;
+	}
+
+	// Link node of conn_t's running (or completed) list.
+	link_t<aio_node_t> m_link;
+
+	// Next node in aio_pool_t's pending list or aio_queue_t.
+	aio_node_t* m_next;
+
+	conn_t* m_conn;
+
+	// Where the task goes after it's completed.
+	aio_queue_t* m_queue;
+
+	bool m_write;
+	fd_t m_fd;
+	int64_t m_offset;
+	char* m_buf;
+	size_t m_size;
+	int64_t m_id;
+
+	// Set by I/O thread.
+	int m_error;
+	size_t m_ok_bytes;
+};
+
+
+// AIO completion queue.
+//
+// Each event loop has its own queue. I/O threads push completed tasks
+// without lock, and wake up the event loop via event fd (only when the
+// queue was empty, so a burst of completions costs one wakeup).
+class aio_queue_t : public waitable_t {
+public:
+	aio_queue_t() : waitable_t(waitable_t::type_aio), m_head(nullptr) {
+	}
+
+	~aio_queue_t() {
+		this->close();
+	}
+
+	// Create event fd.
+	err_t open();
+
+	// Close event fd, and forget the tasks in queue.
+	//
+	// Tasks are owned by conn_t, so they are not deleted.
+	void close();
+
+	fd_t fd() const {
+		return this->m_event;
+	}
+
+	// Push a completed task, it could be called by any thread.
+	void push(aio_node_t* node);
+
+	// Pop all completed tasks in completion order (linked by "m_next").
+	//
+	// It's called by the event loop only.
+	aio_node_t* pop_all();
+
+private:
+	aio_queue_t(const aio_queue_t&) = delete;
+	aio_queue_t& operator=(const aio_queue_t&) = delete;
+
+private:
+	fd_t m_event;
+
+	// Completed tasks, in reverse order.
+	std::atomic<aio_node_t*> m_head;
+};
+
+
+// AIO thread pool.
+//
+// I/O threads do pread() & pwrite() for all event loops of the process.
+// Threads are created when the first task is submitted, so a service
+// that does not use AIO does not have any I/O thread.
+class aio_pool_t {
+public:
+	aio_pool_t() = default;
+
+	~aio_pool_t() {
+		this->stop();
+	}
+
+	// Set number of I/O threads, it must be called before submitting tasks.
+	void threads(int count) {
+		assert(count > 0);
+		this->m_thread_count = count;
+	}
+
+	// Submit a task.
+	err_t submit(aio_node_t* node);
+
+	// Cancel tasks of a file that have not been started.
+	//
+	// Cancelled tasks are completed with ECANCELED.
+	void cancel(fd_t fd);
+
+	// Accept tasks again after stop().
+	void start();
+
+	// Stop all I/O threads.
+	//
+	// Tasks that have not been started are dropped (they are owned by conn_t).
+	// The pool stays stopped until start() is called, i.e. submit() fails
+	// with ECANCELED, so no I/O thread is created while event loops are closing.
+	void stop();
+
+private:
+	aio_pool_t(const aio_pool_t&) = delete;
+	aio_pool_t& operator=(const aio_pool_t&) = delete;
+
+	// I/O thread routine.
+	void run_i();
+
+	// Do file operation.
+	static void execute_i(aio_node_t* node);
+
+private:
+	std::mutex m_mutex;
+	std::condition_variable m_cond;
+	std::vector<std::thread> m_threads;
+	int m_thread_count = 4;
+	bool m_stop = false;
+
+	// Pending tasks (FIFO).
+	aio_node_t* m_first = 0;
+	aio_node_t* m_last = 0;
+};
+
+
+} // namespace c11httpd.
+
+
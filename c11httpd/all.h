@@ -8,7 +8,9 @@
 
 #include "c11httpd/pre__.h"
 #include "c11httpd/acceptor.h"
+#include "c11httpd/aio_pool.h"
 #include "c11httpd/buf.h"
+#include "c11httpd/buf_pool.h"
 #include "c11httpd/conn.h"
 #include "c11httpd/conn_event.h"
 #include "c11httpd/conn_event_adapter.h"
@@ -23,6 +25,7 @@
 #include "c11httpd/http_processor.h"
 #include "c11httpd/http_request.h"
 #include "c11httpd/http_response.h"
+#include "c11httpd/http_router.h"
 #include "c11httpd/http_conn.h"
 #include "c11httpd/http_status.h"
 #include "c11httpd/link.h"
@@ -30,7 +33,13 @@
 #include "c11httpd/worker_pool.h"
 #include "c11httpd/rest_ctrl.h"
 #include "c11httpd/rest_result.h"
+#include "c11httpd/scan.h"
+#include "c11httpd/send_chain.h"
 #include "c11httpd/socket.h"
+#include "c11httpd/static_ctrl.h"
+#include "c11httpd/stats.h"
+#include "c11httpd/timer_wheel.h"
+#include "c11httpd/uring.h"
 #include "c11httpd/utility.h"
 #include "c11httpd/waitable.h"
 
@@ -13,37 +13,73 @@ namespace c11httpd {
 
 
 buf_t::~buf_t() {
-	if (this->m_buf != 0) {
-		::operator delete((void*) m_buf);
-		this->m_buf = 0;
+	this->clear();
+	this->release();
+}
+
+void buf_t::release() {
+	if (this->m_buf == 0 || this->size() > 0) {
+		return;
+	}
+
+	if (this->m_pool != 0) {
+		this->m_pool->free(this->m_buf, this->m_capacity);
+	} else {
+		::operator delete((void*) this->m_buf);
 	}
 
+	this->m_buf = 0;
 	this->m_capacity = 0;
-	this->m_size = 0;
+	this->m_begin = 0;
+	this->m_end = 0;
 }
 
 char* buf_t::back(size_t free_size) {
-	if (this->m_capacity - this->m_size < free_size) {
-		size_t new_capacity = this->m_capacity * 2;
-
-		if (new_capacity - this->m_size < free_size) {
-			new_capacity = this->m_size + free_size;
+	if (this->m_capacity - this->m_end < free_size) {
+		const size_t size = this->size();
+
+		if (this->m_capacity - size >= free_size) {
+			// Free space is enough if content is moved to the beginning.
+			std::memmove(this->m_buf, this->m_buf + this->m_begin, size);
+		} else {
+			size_t new_capacity = this->m_capacity * 2;
+
+			if (new_capacity - size < free_size) {
+				new_capacity = size + free_size;
+			}
+
+			char* new_buf;
+
+			if (this->m_pool != 0) {
+				new_buf = this->m_pool->alloc(new_capacity, &new_capacity);
+			} else {
+				new_buf = (char*)::operator new(new_capacity);
+			}
+
+			if (size > 0) {
+				std::memcpy(new_buf, this->m_buf + this->m_begin, size);
+			}
+
+			if (this->m_pool != 0) {
+				this->m_pool->free(this->m_buf, this->m_capacity);
+			} else {
+				::operator delete((void*) this->m_buf);
+			}
+
+			this->m_buf = new_buf;
+			this->m_capacity = new_capacity;
 		}
 
-		auto new_buf = (char*)::operator new(new_capacity);
-		std::memcpy(new_buf, this->m_buf, this->m_size);
-
-		::operator delete((void*) this->m_buf);
-		this->m_buf = new_buf;
-		this->m_capacity = new_capacity;
+		this->m_begin = 0;
+		this->m_end = size;
 	}
 
-	return this->m_buf + this->m_size;
+	return this->m_buf + this->m_end;
 }
 
 buf_t& buf_t::push_back(const void* data, size_t size) {
 	std::memcpy(this->back(size), data, size);
-	this->m_size += size;
+	this->m_end += size;
 
 	return *this;
 }
@@ -81,18 +117,21 @@ buf_t& buf_t::push_back(unsigned int number) {
 }
 
 void buf_t::erase_front(size_t erased_size) {
-	assert(erased_size <= this->m_size);
+	assert(erased_size <= this->size());
+
+	this->m_begin += erased_size;
 
-	this->m_size -= erased_size;
-	if (this->m_size > 0) {
-		std::memmove(this->m_buf, this->m_buf + erased_size, this->m_size);
+	// If it becomes empty, then re-use the entire buffer.
+	if (this->m_begin == this->m_end) {
+		this->m_begin = 0;
+		this->m_end = 0;
 	}
 }
 
 void buf_t::erase_back(size_t erased_size) {
-	assert(erased_size <= this->m_size);
+	assert(erased_size <= this->size());
 
-	this->m_size -= erased_size;
+	this->m_end -= erased_size;
 }
 
 
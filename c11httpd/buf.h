@@ -7,9 +7,11 @@
 #pragma once
 
 #include "c11httpd/pre__.h"
+#include "c11httpd/buf_pool.h"
 #include "c11httpd/fast_str.h"
 #include <string>
 #include <cstring>
+#include <utility>
 
 
 namespace c11httpd {
@@ -18,12 +20,24 @@ namespace c11httpd {
 // Buffer.
 //
 // conn_t uses this buffer object to save send & recv data.
+// <BR>
+//
+// Content is located in range [m_begin, m_end) of the internal memory.
+// erase_front() just moves "m_begin" forward without copying memory,
+// and the content is moved back to the beginning of the internal memory
+// only when back() could not get enough free space at the end.
+// Therefore, front() might change after calling back(), but not erase_front().
+// <BR>
+//
+// If a buf_pool_t is set, internal memory comes from (and goes back to) it.
 class buf_t {
 public:
-	buf_t() {
+	explicit buf_t(buf_pool_t* pool = 0) {
 		this->m_buf = 0;
 		this->m_capacity = 0;
-		this->m_size = 0;
+		this->m_begin = 0;
+		this->m_end = 0;
+		this->m_pool = pool;
 	}
 
 	~buf_t();
@@ -32,7 +46,30 @@ public:
 	//
 	// We do not free memory so that the buffer could be re-used.
 	void clear() {
-		this->m_size = 0;
+		this->m_begin = 0;
+		this->m_end = 0;
+	}
+
+	// Free internal memory (or give it back to the pool) if it's empty.
+	void release();
+
+	buf_pool_t* pool() const {
+		return this->m_pool;
+	}
+
+	// Set memory pool, it must be called when there is no internal memory.
+	void pool(buf_pool_t* pool) {
+		assert(this->m_buf == 0);
+		this->m_pool = pool;
+	}
+
+	// Exchange content (and internal memory) with another buffer.
+	void swap(buf_t& another) {
+		std::swap(this->m_buf, another.m_buf);
+		std::swap(this->m_capacity, another.m_capacity);
+		std::swap(this->m_begin, another.m_begin);
+		std::swap(this->m_end, another.m_end);
+		std::swap(this->m_pool, another.m_pool);
 	}
 
 	size_t capacity() const {
@@ -40,33 +77,38 @@ public:
 	}
 
 	size_t size() const {
-		return this->m_size;
+		return this->m_end - this->m_begin;
 	}
 
 	void size(size_t new_size) {
-		assert(new_size <= this->m_capacity);
+		assert(this->m_begin + new_size <= this->m_capacity);
 
-		this->m_size = new_size;
+		this->m_end = this->m_begin + new_size;
 	}
 
 	void add_size(size_t added_size) {
-		assert(this->m_size + added_size <= this->m_capacity);
+		assert(this->m_end + added_size <= this->m_capacity);
 
-		this->m_size += added_size;
+		this->m_end += added_size;
 	}
 
+	// Free space at the end.
 	size_t free_size() const {
-		return this->m_capacity - this->m_size;
+		return this->m_capacity - this->m_end;
 	}
 
 	char* front() const {
-		return this->m_buf;
+		return this->m_buf + this->m_begin;
 	}
 
 	char* back() const {
-		return this->m_buf + this->m_size;
+		return this->m_buf + this->m_end;
 	}
 
+	// Get free space at the end.
+	//
+	// If free space is not enough, content might be moved
+	// (or re-allocated), so front() might change.
 	char* back(size_t free_size);
 
 	buf_t& push_back(const void* data, size_t size);
@@ -101,6 +143,7 @@ public:
 		return this->push_back(number);
 	}
 
+	// Remove data from the beginning, it does not copy memory.
 	void erase_front(size_t erased_size);
 	void erase_back(size_t erased_size);
 
@@ -113,13 +156,13 @@ public:
 	}
 
 	const char& at(size_t index) const {
-		assert(index < this->m_size);
-		return this->m_buf[index];
+		assert(index < this->size());
+		return this->m_buf[this->m_begin + index];
 	}
 
 	char& at(size_t index) {
-		assert(index < this->m_size);
-		return this->m_buf[index];
+		assert(index < this->size());
+		return this->m_buf[this->m_begin + index];
 	}
 
 private:
@@ -142,7 +185,12 @@ private:
 private:
 	char* m_buf;
 	size_t m_capacity;
-	size_t m_size;
+
+	// Content range [m_begin, m_end).
+	size_t m_begin;
+	size_t m_end;
+
+	buf_pool_t* m_pool;
 };
 
 
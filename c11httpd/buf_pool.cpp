@@ -0,0 +1,113 @@
+/**
+ * Buffer memory pool.
+ *
+ * Copyright (c) 2015 Alex Jin (toalexjin@hotmail.com)
+ */
+
+#include "c11httpd/buf_pool.h"
+#include <new>
+
+
+namespace c11httpd {
+
+
+buf_pool_t::buf_pool_t() {
+	for (int i = 0; i < classes; ++i) {
+		this->m_free[i] = 0;
+	}
+
+	this->m_cached = 0;
+	this->m_limit = 16 * 1024 * 1024;
+}
+
+buf_pool_t::~buf_pool_t() {
+	this->trim();
+}
+
+void buf_pool_t::limit(size_t bytes) {
+	this->m_limit = bytes;
+
+	if (this->m_cached > this->m_limit) {
+		// Free larger blocks first.
+		for (int i = classes - 1; i >= 0 && this->m_cached > this->m_limit; --i) {
+			while (this->m_free[i] != 0 && this->m_cached > this->m_limit) {
+				block_t* const block = this->m_free[i];
+
+				this->m_free[i] = block->m_next;
+				this->m_cached -= (size_t(1) << (min_shift + i));
+				::operator delete((void*) block);
+			}
+		}
+	}
+}
+
+char* buf_pool_t::alloc(size_t size, size_t* capacity) {
+	assert(capacity != 0);
+
+	if (size > (size_t(1) << max_shift)) {
+		*capacity = size;
+		return (char*) ::operator new(size);
+	}
+
+	int index = 0;
+	while ((size_t(1) << (min_shift + index)) < size) {
+		++ index;
+	}
+
+	*capacity = size_t(1) << (min_shift + index);
+
+	block_t* const block = this->m_free[index];
+	if (block != 0) {
+		this->m_free[index] = block->m_next;
+		this->m_cached -= *capacity;
+		return (char*) block;
+	}
+
+	return (char*) ::operator new(*capacity);
+}
+
+void buf_pool_t::free(char* ptr, size_t capacity) {
+	if (ptr == 0) {
+		return;
+	}
+
+	const int index = class_i(capacity);
+
+	if (index < 0 || this->m_cached + capacity > this->m_limit) {
+		::operator delete((void*) ptr);
+		return;
+	}
+
+	block_t* const block = (block_t*) ptr;
+	block->m_next = this->m_free[index];
+	this->m_free[index] = block;
+	this->m_cached += capacity;
+}
+
+void buf_pool_t::trim() {
+	for (int i = 0; i < classes; ++i) {
+		while (this->m_free[i] != 0) {
+			block_t* const block = this->m_free[i];
+
+			this->m_free[i] = block->m_next;
+			::operator delete((void*) block);
+		}
+	}
+
+	this->m_cached = 0;
+}
+
+int buf_pool_t::class_i(size_t capacity) {
+	for (int i = 0; i < classes; ++i) {
+		if ((size_t(1) << (min_shift + i)) == capacity) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+
+} // namespace c11httpd.
+
+
@@ -0,0 +1,87 @@
+/**
+ * Buffer memory pool.
+ *
+ * Copyright (c) 2015 Alex Jin (toalexjin@hotmail.com)
+ */
+
+#pragma once
+
+#include "c11httpd/pre__.h"
+
+
+namespace c11httpd {
+
+
+// Buffer memory pool.
+//
+// Memory blocks are grouped by size classes (powers of 2, from 512 bytes
+// to 1 MB). A freed block is cached in the free list of its class,
+// unless cached memory would exceed the limit (high-water mark).
+// Larger blocks are not cached.
+// <BR>
+//
+// Each event loop has its own pool, which is shared by buffers of
+// all its connections. An empty buffer gives its memory back (see
+// buf_t::release()), so memory usage follows active connections,
+// not the historical peak of each connection.
+// <BR>
+//
+// buf_pool_t is used by one event loop only, it's not thread-safe.
+class buf_pool_t {
+public:
+	enum {
+		min_shift = 9,
+		max_shift = 20,
+		classes = max_shift - min_shift + 1
+	};
+
+	buf_pool_t();
+	~buf_pool_t();
+
+	// Max bytes of cached free blocks.
+	size_t limit() const {
+		return this->m_limit;
+	}
+
+	// Set max bytes of cached free blocks, extra blocks are freed.
+	void limit(size_t bytes);
+
+	// Bytes of cached free blocks.
+	size_t cached() const {
+		return this->m_cached;
+	}
+
+	// Allocate a block of at least "size" bytes.
+	//
+	// "capacity" receives the real size of the block,
+	// which must be passed to free().
+	char* alloc(size_t size, size_t* capacity);
+
+	// Give a block back.
+	void free(char* ptr, size_t capacity);
+
+	// Free all cached blocks.
+	void trim();
+
+private:
+	buf_pool_t(const buf_pool_t&) = delete;
+	buf_pool_t& operator=(const buf_pool_t&) = delete;
+
+	// A free block, the link is saved in the block itself.
+	struct block_t {
+		block_t* m_next;
+	};
+
+	// Get size class of a capacity, or -1 if it's not cached.
+	static int class_i(size_t capacity);
+
+private:
+	block_t* m_free[classes];
+	size_t m_cached;
+	size_t m_limit;
+};
+
+
+} // namespace c11httpd.
+
+
@@ -18,9 +18,23 @@ config_t::config_t() {
 void config_t::set_default() {
 	this->m_flags = keep_alive | response_date;
 	this->m_worker_processes = 0;
+	this->m_worker_threads = 0;
 	this->m_backlog = 10;
 	this->m_max_epoll_events = 256;
 	this->m_max_free_connection = 128;
+	this->m_prealloc_connections = 0;
+	this->m_max_accept_batch = 16;
+	this->m_read_budget = 64 * 1024;
+	this->m_buf_pool_limit = 16 * 1024 * 1024;
+	this->m_aio_threads = 4;
+	this->m_engine = engine_epoll;
+	this->m_uring_buffers = 256;
+	this->m_uring_buffer_size = 4096;
+	this->m_keep_alive_timeout = 75000;
+	this->m_max_header_size = 64 * 1024;
+	this->m_max_body_size = 10 * 1024 * 1024;
+	this->m_header_timeout = 60000;
+	this->m_body_timeout = 60000;
 }
 
 
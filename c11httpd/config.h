@@ -20,7 +20,35 @@ public:
 		keep_alive = 1,
 
 		// Support response "Date:???" or not.
-		response_date = (1 << 1)
+		response_date = (1 << 1),
+
+		// Each worker process listens to its own SO_REUSEPORT sockets,
+		// so that Linux kernel distributes incoming connections evenly.
+		//
+		// If it's enabled and there are worker processes, the main process
+		// closes its listening sockets before creating worker processes.
+		reuse_port = (1 << 2),
+
+		// Register listening sockets with EPOLLEXCLUSIVE (level-triggered),
+		// so that only one worker process is woken up by incoming connections.
+		//
+		// It's useful when worker processes share the same listening sockets
+		// (e.g. "reuse_port" is not usable). Linux kernel 4.5 (or above) is required.
+		exclusive_accept = (1 << 3)
+	};
+
+	// Event loop engines.
+	enum {
+		// Linux epoll (default).
+		engine_epoll = 0,
+
+		// Linux io_uring, Linux kernel 6.0 (or above) is required.
+		//
+		// Connections are accepted by multishot accept, data is received
+		// into provided buffers by multishot recv, and sending requests
+		// of all connections are submitted in one batch per loop iteration.
+		// conn_event_t callbacks are the same as epoll engine.
+		engine_uring = 1
 	};
 
 public:
@@ -57,6 +85,24 @@ public:
 		this->m_worker_processes = worker_processes;
 	}
 
+	// Get number of worker threads.
+	int worker_threads() const {
+		return this->m_worker_threads;
+	}
+
+	// Set number of worker threads (in each worker process).
+	//
+	// -# If the number is zero, then the process handles connections
+	//    in its main thread.
+	// -# If the number is greater than zero, then each worker thread runs
+	//    its own event loop and handles connections, the main thread
+	//    only handles Linux signals. Note that the event handler object
+	//    is shared by all worker threads, so it must be thread-safe.
+	void worker_threads(int worker_threads) {
+		assert(worker_threads >= 0);
+		this->m_worker_threads = worker_threads;
+	}
+
 	int backlog() const {
 		return this->m_backlog;
 	}
@@ -87,15 +133,198 @@ public:
 		}
 	}
 
+	// Number of connection objects (and their context objects, see
+	// conn_event_t::new_ctx()) preallocated by each event loop at startup.
+	//
+	// They are contiguous in memory and kept for re-use regardless of
+	// max_free_connection(), so a burst of connections does not call
+	// memory allocator or hit page faults.
+	int prealloc_connections() const {
+		return this->m_prealloc_connections;
+	}
+
+	void prealloc_connections(int value) {
+		if (value >= 0) {
+			this->m_prealloc_connections = value;
+		}
+	}
+
+	// Max number of connections accepted from a listening socket
+	// per wakeup (epoll engine), so that a burst of new connections
+	// does not starve I/O of existing connections.
+	int max_accept_batch() const {
+		return this->m_max_accept_batch;
+	}
+
+	void max_accept_batch(int value) {
+		if (value > 0) {
+			this->m_max_accept_batch = value;
+		}
+	}
+
+	// Max bytes read from a connection per wakeup (epoll engine).
+	//
+	// A connection that used up its budget is served again after other
+	// ready connections, so a fast uploader could not monopolize the event loop.
+	int read_budget() const {
+		return this->m_read_budget;
+	}
+
+	void read_budget(int value) {
+		if (value > 0) {
+			this->m_read_budget = value;
+		}
+	}
+
+	// Max bytes of free buffer memory that each event loop caches
+	// for re-use (high-water mark of buf_pool_t). Empty connection
+	// buffers always give their memory back to the pool.
+	int buf_pool_limit() const {
+		return this->m_buf_pool_limit;
+	}
+
+	void buf_pool_limit(int value) {
+		if (value >= 0) {
+			this->m_buf_pool_limit = value;
+		}
+	}
+
+	// Number of I/O threads (in each process) that execute AIO tasks.
+	//
+	// Threads are created when the first AIO task is submitted.
+	int aio_threads() const {
+		return this->m_aio_threads;
+	}
+
+	void aio_threads(int value) {
+		if (value > 0) {
+			this->m_aio_threads = value;
+		}
+	}
+
+	// Get event loop engine (engine_epoll or engine_uring).
+	int engine() const {
+		return this->m_engine;
+	}
+
+	void engine(int value) {
+		if (value == engine_epoll || value == engine_uring) {
+			this->m_engine = value;
+		}
+	}
+
+	// Number of provided receive buffers of each io_uring event loop,
+	// it's rounded up to a power of 2.
+	int uring_buffers() const {
+		return this->m_uring_buffers;
+	}
+
+	void uring_buffers(int value) {
+		if (value > 0 && value <= 32768) {
+			this->m_uring_buffers = value;
+		}
+	}
+
+	// Size of each provided receive buffer of io_uring.
+	int uring_buffer_size() const {
+		return this->m_uring_buffer_size;
+	}
+
+	void uring_buffer_size(int value) {
+		if (value > 0) {
+			this->m_uring_buffer_size = value;
+		}
+	}
+
+	// Max idle time (in milliseconds) of a keep-alive connection, i.e. there is
+	// no partial request received, or pending response data is not moving.
+	// Zero means no limit.
+	int keep_alive_timeout() const {
+		return this->m_keep_alive_timeout;
+	}
+
+	void keep_alive_timeout(int value) {
+		if (value >= 0) {
+			this->m_keep_alive_timeout = value;
+		}
+	}
+
+	// Max bytes of request line and header. A request whose header is
+	// bigger is rejected as soon as so many bytes are received, rather
+	// than buffering it unbounded.
+	int max_header_size() const {
+		return this->m_max_header_size;
+	}
+
+	void max_header_size(int value) {
+		if (value > 0) {
+			this->m_max_header_size = value;
+		}
+	}
+
+	// Max bytes of a request body that is received into memory as a whole.
+	//
+	// It does not apply to APIs that receive body chunk by chunk
+	// (see rest_ctrl_t::add_stream()), which run in constant memory.
+	int64_t max_body_size() const {
+		return this->m_max_body_size;
+	}
+
+	void max_body_size(int64_t value) {
+		if (value >= 0) {
+			this->m_max_body_size = value;
+		}
+	}
+
+	// Max time (in milliseconds) to receive a whole request header since
+	// its first byte arrived. It's not extended by new data, so a client
+	// sending header slowly (i.e. slowloris) could not hold a connection.
+	// Zero means no limit.
+	int header_timeout() const {
+		return this->m_header_timeout;
+	}
+
+	void header_timeout(int value) {
+		if (value >= 0) {
+			this->m_header_timeout = value;
+		}
+	}
+
+	// Max time (in milliseconds) between two successive reads of request
+	// body (see conn_event_t::result_wait_body). Zero means no limit.
+	int body_timeout() const {
+		return this->m_body_timeout;
+	}
+
+	void body_timeout(int value) {
+		if (value >= 0) {
+			this->m_body_timeout = value;
+		}
+	}
+
 	// Set all to default values.
 	void set_default();
 
 private:
 	uint32_t m_flags;
 	int m_worker_processes;
+	int m_worker_threads;
 	int m_backlog;
 	int m_max_epoll_events;
 	int m_max_free_connection;
+	int m_prealloc_connections;
+	int m_max_accept_batch;
+	int m_read_budget;
+	int m_buf_pool_limit;
+	int m_aio_threads;
+	int m_engine;
+	int m_uring_buffers;
+	int m_uring_buffer_size;
+	int m_keep_alive_timeout;
+	int m_max_header_size;
+	int64_t m_max_body_size;
+	int m_header_timeout;
+	int m_body_timeout;
 };
 
 
@@ -5,17 +5,22 @@
  */
 
 #include "c11httpd/conn.h"
+#include <algorithm>
+#include <cstring>
 #include <errno.h>
-#include <signal.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
 
 
 namespace c11httpd {
 
 
-const int conn_t::aio_signal_id = SIGRTMIN + 1;
-
 conn_t::~conn_t() {
 	this->close();
+
+	// acceptor_t destroys connections after I/O threads are stopped,
+	// so nobody is using the running AIO tasks.
+	this->m_aio_running.clear();
 }
 
 void conn_t::close() {
@@ -25,33 +30,83 @@ void conn_t::close() {
 		this->ctx()->clear();
 	}
 
-	this->m_ip.clear();
 	this->m_sd.close();
-	this->m_port = 0;
-	this->m_ipv6 = false;
+	this->peer(0);
+	this->m_send_chain.clear();
+	this->m_flight_chain.clear();
 	this->m_recv_buf.clear();
 	this->m_send_buf.clear();
-	this->m_send_offset = 0;
+	this->m_flight_buf.clear();
+	this->release_bufs();
+	this->m_uring_state = uring_state_t();
 	this->m_last_event_result = 0;
+	this->m_readable = false;
+	this->m_writable = false;
+	this->m_ready_state = false;
+	this->m_timer.cancel();
+	this->m_timer_phase = timer_none;
 
 	// Remove completed AIO tasks.
 	//
 	// Note that we do NOT remove running AIO tasks
-	// because those objects will be used by on_signalled_i().
+	// because those objects are being used by I/O threads.
 	this->m_aio_completed.clear();
 	this->m_aio_completed_count = 0;
 }
 
+void conn_t::peer(const struct sockaddr_storage* addr) {
+	if (addr != 0) {
+		// Only the real size of the address is copied.
+		std::memcpy(&this->m_addr, addr, addr->ss_family == AF_INET6
+			? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in));
+	} else {
+		this->m_addr.ss_family = AF_UNSPEC;
+	}
+
+	this->m_ip.clear();
+}
+
+const struct sockaddr_storage* conn_t::peer() const {
+	if (this->m_addr.ss_family == AF_UNSPEC) {
+		if (!this->m_sd.is_open() || !this->m_sd.peer(&this->m_addr)) {
+			this->m_addr.ss_family = AF_UNSPEC;
+			return 0;
+		}
+	}
+
+	return &this->m_addr;
+}
+
 const std::string& conn_t::ip() const {
+	if (this->m_ip.empty()) {
+		const auto addr = this->peer();
+		uint16_t port;
+		bool ipv6;
+
+		if (addr != 0) {
+			socket_t::parse_addr(addr, &this->m_ip, &port, &ipv6);
+		}
+	}
+
 	return this->m_ip;
 }
 
 uint16_t conn_t::port() const {
-	return this->m_port;
+	const auto addr = this->peer();
+
+	if (addr == 0) {
+		return 0;
+	} else if (addr->ss_family == AF_INET6) {
+		return ntohs(((const struct sockaddr_in6*) addr)->sin6_port);
+	} else {
+		return ntohs(((const struct sockaddr_in*) addr)->sin_port);
+	}
 }
 
 bool conn_t::ipv6() const {
-	return this->m_ipv6;
+	const auto addr = this->peer();
+
+	return addr != 0 && addr->ss_family == AF_INET6;
 }
 
 buf_t& conn_t::recv_buf() {
@@ -62,42 +117,72 @@ buf_t& conn_t::send_buf() {
 	return this->m_send_buf;
 }
 
-err_t conn_t::recv(size_t* new_recv_size, bool* peer_closed) {
+send_chain_t& conn_t::send_chain() {
+	return this->m_send_chain;
+}
+
+err_t conn_t::recv(size_t budget, char* spill, size_t spill_size,
+	size_t* new_recv_size, bool* peer_closed) {
 	err_t ret;
-	const size_t unit_size = 1024;
 	size_t ok_bytes;
 
+	assert(budget > 0);
+	assert(spill != 0 && spill_size > 0);
 	assert(new_recv_size != 0);
 	assert(peer_closed != 0);
 
 	*new_recv_size = 0;
 	*peer_closed = false;
 
-	this->m_recv_buf.back(unit_size);
-	while (1) {
-		ret = this->sock().recv(this->m_recv_buf.back(), this->m_recv_buf.free_size(), &ok_bytes);
+	while (*new_recv_size < budget) {
+		const size_t left = budget - *new_recv_size;
+		const size_t free_size = std::min(this->m_recv_buf.free_size(), left);
+		struct iovec iov[2];
+		int count = 0;
+
+		// Free space of the buffer is filled first, and the rest goes to
+		// the spill buffer. So the buffer is not enlarged in advance,
+		// and it grows (at most once) only by what was actually read.
+		if (free_size > 0) {
+			iov[count].iov_base = this->m_recv_buf.back();
+			iov[count].iov_len = free_size;
+			++ count;
+		}
+
+		if (left > free_size) {
+			iov[count].iov_base = spill;
+			iov[count].iov_len = std::min(spill_size, left - free_size);
+			++ count;
+		}
+
+		ret = this->sock().readv(iov, count, &ok_bytes);
 		if (!ret) {
 			if (ret == EAGAIN || ret == EWOULDBLOCK) {
 				ret.set_ok();
 			}
 
+			this->m_readable = false;
 			break;
 		}
 
 		if (ok_bytes == 0) {
 			*peer_closed = true;
+			this->m_readable = false;
 			break;
 		}
 
 		*new_recv_size += ok_bytes;
-		this->m_recv_buf.add_size(ok_bytes);
 
-		// If no free buffer any more, it probably means there are more data to read.
-		// Otherwise, it should be no more data to read and we do not need to re-allocate buffer.
-		// Anyway, we should not stop until getting EAGAIN or EWOULDBLOCK.
-		if (this->m_recv_buf.free_size() == 0) {
-			this->m_recv_buf.back(unit_size);
+		if (ok_bytes <= free_size) {
+			this->m_recv_buf.add_size(ok_bytes);
+		} else {
+			this->m_recv_buf.add_size(free_size);
+			this->m_recv_buf.push_back(spill, ok_bytes - free_size);
 		}
+
+		// Even if less data than requested was read, we should not stop
+		// until getting EAGAIN or EWOULDBLOCK (or budget is used up),
+		// otherwise a FIN arriving with the data would be missed.
 	}
 
 	// If there are free space, then add a null-terminal to make debug easier.
@@ -115,26 +200,32 @@ err_t conn_t::send(size_t* new_send_size) {
 	assert(new_send_size != 0);
 	*new_send_size = 0;
 
-	if (this->m_send_offset == this->m_send_buf.size()) {
-		return ret;
-	}
+	while (this->m_send_buf.size() > 0 || !this->m_send_chain.empty()) {
+		fd_t file;
+		int64_t offset;
+		size_t size;
+
+		if (this->m_send_chain.empty()) {
+			ret = this->sock().send(this->m_send_buf.front(),
+					this->m_send_buf.size(), &ok_bytes);
+		} else if (this->m_send_chain.front_file(&file, &offset, &size)) {
+			ret = this->sock().sendfile(file, offset, size, &ok_bytes);
+		} else {
+			struct iovec iov[send_chain_t::max_iov];
+			const int count = this->m_send_chain.fill(this->m_send_buf, iov, send_chain_t::max_iov);
+
+			ret = this->sock().writev(iov, count, &ok_bytes);
+		}
 
-	while (true) {
-		ret = this->sock().send(this->m_send_buf.front() + this->m_send_offset,
-				this->m_send_buf.size() - this->m_send_offset, &ok_bytes);
 		if (!ret) {
 			break;
 		}
 
 		*new_send_size += ok_bytes;
-		this->m_send_offset += ok_bytes;
 
-		// If all data has been sent, then reset state.
-		if (this->m_send_offset == this->m_send_buf.size()) {
-			this->m_send_offset = 0;
-			this->m_send_buf.clear();
-			break;
-		}
+		// Sent data is removed without copying memory. If all data
+		// has been sent, the buffer is reset to its beginning.
+		this->m_send_chain.consume(&this->m_send_buf, ok_bytes);
 	}
 
 	return ret;
@@ -143,11 +234,6 @@ err_t conn_t::send(size_t* new_send_size) {
 void conn_t::on_aio_completed_i(conn_t::aio_node_t* aio_node) {
 	assert(aio_node != 0);
 
-	aio_node->m_error = aio_error(&aio_node->m_cb);
-	if (aio_node->m_error != EINPROGRESS) {
-		aio_node->m_ok_bytes = aio_return(&aio_node->m_cb);
-	}
-
 	// Move the node from running list to completed list.
 	aio_node->m_link.unlink();
 	this->m_aio_running_count--;
@@ -162,92 +248,68 @@ void conn_t::on_aio_completed_i(conn_t::aio_node_t* aio_node) {
 
 err_t conn_t::aio_read(fd_t fd, int64_t offset,
 	char* buf, size_t size, int64_t* id) {
-
-	assert(fd.is_open());
-	assert(offset >= 0);
-	assert(buf != 0 || size == 0);
-
-	err_t ret;
-	aio_node_t* node = new aio_node_t(this);
-
-	node->m_id = (++ m_aio_sequence);
-	node->m_cb.aio_fildes = fd.get();
-	node->m_cb.aio_offset = offset;
-	node->m_cb.aio_buf = (void*) buf;
-	node->m_cb.aio_nbytes = size;
-
-	node->m_cb.aio_sigevent.sigev_notify = SIGEV_SIGNAL;
-	node->m_cb.aio_sigevent.sigev_signo = conn_t::aio_signal_id;
-	node->m_cb.aio_sigevent.sigev_value.sival_ptr = node;
-
-	if (::aio_read(&node->m_cb) == 0) {
-		this->m_aio_running.push_back(&node->m_link);
-		this->m_aio_running_count++;
-
-		if (id != 0) {
-			*id = node->m_id;
-		}
-	} else {
-		ret.set_current();
-		delete node;
-		node = 0;
-
-		if (id != 0) {
-			*id = 0;
-		}
-	}
-
-	return ret;
+	return this->aio_submit_i(false, fd, offset, buf, size, id);
 }
 
 err_t conn_t::aio_write(fd_t fd, int64_t offset,
 	const char* buf, size_t size, int64_t* id) {
+	return this->aio_submit_i(true, fd, offset, (char*) buf, size, id);
+}
+
+err_t conn_t::aio_submit_i(bool write, fd_t fd, int64_t offset,
+	char* buf, size_t size, int64_t* id) {
 
 	assert(fd.is_open());
 	assert(offset >= 0);
 	assert(buf != 0 || size == 0);
 
 	err_t ret;
-	aio_node_t* node = new aio_node_t(this);
+	aio_node_t* node;
 
-	node->m_id = (++ m_aio_sequence);
-	node->m_cb.aio_fildes = fd.get();
-	node->m_cb.aio_offset = offset;
-	node->m_cb.aio_buf = (void*) buf;
-	node->m_cb.aio_nbytes = size;
-
-	node->m_cb.aio_sigevent.sigev_notify = SIGEV_SIGNAL;
-	node->m_cb.aio_sigevent.sigev_signo = conn_t::aio_signal_id;
-	node->m_cb.aio_sigevent.sigev_value.sival_ptr = node;
+	if (id != 0) {
+		*id = 0;
+	}
 
-	if (::aio_write(&node->m_cb) == 0) {
-		this->m_aio_running.push_back(&node->m_link);
-		this->m_aio_running_count++;
+	if (this->m_aio_pool == 0 || this->m_aio_queue == 0) {
+		return ENOTSUP;
+	}
 
-		if (id != 0) {
-			*id = node->m_id;
-		}
-	} else {
-		ret.set_current();
+	node = new aio_node_t(this);
+	node->m_id = (++ m_aio_sequence);
+	node->m_queue = this->m_aio_queue;
+	node->m_write = write;
+	node->m_fd = fd;
+	node->m_offset = offset;
+	node->m_buf = buf;
+	node->m_size = size;
+
+	// Add it to running list first, an I/O thread might complete it
+	// right away (but it's handled by the event loop thread later).
+	this->m_aio_running.push_back(&node->m_link);
+	this->m_aio_running_count++;
+
+	ret = this->m_aio_pool->submit(node);
+	if (!ret) {
+		node->m_link.unlink();
+		this->m_aio_running_count--;
 		delete node;
-		node = 0;
+		return ret;
+	}
 
-		if (id != 0) {
-			*id = 0;
-		}
+	if (id != 0) {
+		*id = node->m_id;
 	}
 
 	return ret;
 }
 
 err_t conn_t::aio_cancel(fd_t fd) {
-	err_t ret;
-
-	if (::aio_cancel(fd.get(), 0) == -1) {
-		ret.set_current();
+	if (this->m_aio_pool == 0) {
+		return ENOTSUP;
 	}
 
-	return ret;
+	this->m_aio_pool->cancel(fd);
+	return err_t();
 }
 
 void conn_t::popup_aio_completed(std::vector<aio_t>* completed) {
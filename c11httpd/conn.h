@@ -7,14 +7,16 @@
 #pragma once
 
 #include "c11httpd/pre__.h"
+#include "c11httpd/aio_pool.h"
 #include "c11httpd/buf.h"
 #include "c11httpd/conn_session.h"
 #include "c11httpd/ctx_setter.h"
 #include "c11httpd/fd.h"
 #include "c11httpd/link.h"
 #include "c11httpd/listen.h"
+#include "c11httpd/send_chain.h"
 #include "c11httpd/socket.h"
-#include <aio.h>
+#include "c11httpd/timer_wheel.h"
 #include <map>
 #include <memory>
 #include <string>
@@ -30,53 +32,72 @@ namespace c11httpd {
 // the conn_t object might be re-used by acceptor_t for better performance.
 class conn_t : public waitable_t, public conn_session_t, public ctx_setter_t {
 public:
-	class aio_node_t {
-	public:
-		aio_node_t(conn_t* conn)
-			: m_link(uintptr_t(&this->m_link) - uintptr_t(this)) {
-			this->m_conn = conn;
-			bzero(&m_cb, sizeof(m_cb));
-			m_id = 0;
-			m_error = 0;
-			m_ok_bytes = 0;
-		}
-
-		aio_node_t(const aio_node_t&) = delete;
-		aio_node_t& operator=(const aio_node_t&) = delete;
-
-		void to_pub(aio_t* pub) const {
-			assert(pub != 0);
-
-			pub->m_id = m_id;
-			pub->m_error = m_error;
-			pub->m_fd = m_cb.aio_fildes;
-			pub->m_offset = m_cb.aio_offset;
-			pub->m_buf = (char*) m_cb.aio_buf;
-			pub->m_size = m_cb.aio_nbytes;
-			pub->m_ok_bytes = m_ok_bytes;
-		}
-
-		link_t<aio_node_t> m_link;
-		conn_t* m_conn;
-		struct aiocb m_cb;
-		int64_t m_id;
-		err_t m_error;
-		size_t m_ok_bytes;
+	typedef c11httpd::aio_node_t aio_node_t;
+
+	// io_uring state, used by acceptor_t (config_t::engine_uring).
+	struct uring_state_t {
+		// Number of io_uring requests in flight.
+		int m_ops = 0;
+
+		// Multishot recv is armed.
+		bool m_receiving = false;
+
+		// Receiving is stopped until pending data is sent.
+		bool m_paused = false;
+
+		// flight_buf() (and flight_chain()) is being sent.
+		bool m_sending = false;
+
+		// Message of the sending request in flight if flight_chain()
+		// is not empty.
+		struct msghdr m_msg;
+		struct iovec m_iov[send_chain_t::max_iov];
+
+		// The connection is in the batch of sending requests.
+		bool m_queued = false;
+
+		// The connection is being closed, it will be garbage-collected
+		// after all requests in flight are completed.
+		bool m_closing = false;
+	};
+
+	// Which timeout the connection is waiting for, used by acceptor_t.
+	enum {
+		// No timer (e.g. AIO tasks are running).
+		timer_none = 0,
+
+		// config_t::keep_alive_timeout().
+		timer_idle,
+
+		// config_t::header_timeout().
+		timer_header,
+
+		// config_t::body_timeout().
+		timer_body
 	};
 
 public:
-	conn_t(const socket_t& sd, const std::string& ip, uint16_t port, bool ipv6)
+	// If "addr" is null, peer address is got by getpeername() when it's needed.
+	conn_t(const socket_t& sd, const struct sockaddr_storage* addr)
 		: waitable_t(waitable_t::type_conn),
-		m_ip(ip), m_sd(sd), m_port(port), m_ipv6(ipv6),
+		m_sd(sd),
 		m_link(uintptr_t(&this->m_link) - uintptr_t(this)),
+		m_timer(this),
 		m_aio_running_count(0),
 		m_aio_completed_count(0),
 		m_aio_sequence(0),
-		m_aio_wait_state(false) {
+		m_aio_wait_state(false),
+		m_aio_pool(0),
+		m_aio_queue(0),
+		m_owner(0) {
 
 		assert(this == this->m_link.get());
-		this->m_send_offset = 0;
+		this->peer(addr);
 		this->m_last_event_result = 0;
+		this->m_readable = false;
+		this->m_writable = false;
+		this->m_ready_state = false;
+		this->m_timer_phase = timer_none;
 	}
 
 	virtual ~conn_t();
@@ -95,26 +116,53 @@ public:
 		this->m_sd = sd;
 	}
 
-	void ip(const std::string& ip) {
-		this->m_ip = ip;
-	}
-
-	void port(uint16_t port) {
-		this->m_port = port;
-	}
-
-	void ipv6(bool ipv6) {
-		this->m_ipv6 = ipv6;
-	}
+	// Set raw address of peer side, it's formatted by ip() when needed.
+	//
+	// If "addr" is null, it's got by getpeername() when needed.
+	void peer(const struct sockaddr_storage* addr);
 
 	// Following three functions are defined
 	// in parent class conn_session_t, so they are virtual.
+	//
+	// Most handlers never look at peer address,
+	// so ip() is formatted only on the first call.
 	virtual const std::string& ip() const;
 	virtual uint16_t port() const;
 	virtual bool ipv6() const;
 
 	size_t pending_send_size() const {
-		return this->m_send_buf.size() - this->m_send_offset;
+		return this->m_send_buf.size() + this->m_flight_buf.size()
+			+ this->m_send_chain.size() + this->m_flight_chain.size();
+	}
+
+	// Socket has data to read (edge-triggered EPOLLIN was reported,
+	// and recv() has not got EAGAIN yet).
+	bool readable() const {
+		return this->m_readable;
+	}
+
+	void readable(bool flag) {
+		this->m_readable = flag;
+	}
+
+	// Socket buffer has free space (send() has not got EAGAIN
+	// since last edge-triggered EPOLLOUT).
+	bool writable() const {
+		return this->m_writable;
+	}
+
+	void writable(bool flag) {
+		this->m_writable = flag;
+	}
+
+	// The connection is in acceptor_t's ready list, i.e. it used up
+	// its read budget and will continue to read later.
+	bool ready_state() const {
+		return this->m_ready_state;
+	}
+
+	void ready_state(bool flag) {
+		this->m_ready_state = flag;
 	}
 
 	uint32_t last_event_result() const {
@@ -128,12 +176,70 @@ public:
 	buf_t& recv_buf();
 	buf_t& send_buf();
 
-	// Receive data.
-	err_t recv(size_t* new_recv_size, bool* peer_closed);
+	// Data being sent by io_uring.
+	//
+	// Memory of send_buf() might be re-allocated while a sending request
+	// is in flight, so acceptor_t swaps its content to this buffer first.
+	buf_t& flight_buf() {
+		return this->m_flight_buf;
+	}
+
+	// Chain of send_buf().
+	virtual send_chain_t& send_chain();
+
+	// Chain of flight_buf().
+	send_chain_t& flight_chain() {
+		return this->m_flight_chain;
+	}
+
+	uring_state_t& uring_state() {
+		return this->m_uring_state;
+	}
+
+	// Set memory pool of buffers, it must be called when buffers are empty.
+	void pool(buf_pool_t* pool) {
+		this->m_recv_buf.pool(pool);
+		this->m_send_buf.pool(pool);
+		this->m_flight_buf.pool(pool);
+	}
+
+	// Give memory of empty buffers back to the pool, so that
+	// an idle connection does not hold any buffer memory.
+	void release_bufs() {
+		this->m_recv_buf.release();
+		this->m_send_buf.release();
+		this->m_flight_buf.release();
+	}
+
+	// Receive at most "budget" bytes.
+	//
+	// Data is read (by readv) into free space of recv_buf() and then
+	// into "spill", which is shared by connections of an event loop.
+	// Only data that exceeds free space is copied to recv_buf().
+	// <BR>
+	//
+	// readable() becomes false if there is no more data to read
+	// (i.e. EAGAIN, error or peer closed), otherwise the budget was used up.
+	err_t recv(size_t budget, char* spill, size_t spill_size,
+		size_t* new_recv_size, bool* peer_closed);
 
 	// Send data.
+	//
+	// If send_chain() is not empty, data is sent by writev()
+	// (and sendfile() for file segments).
 	err_t send(size_t* new_send_size);
 
+	// Event loop that the connection belongs to.
+	//
+	// It's used by acceptor_t to find the right worker thread.
+	void* owner() const {
+		return this->m_owner;
+	}
+
+	void owner(void* owner) {
+		this->m_owner = owner;
+	}
+
 	// Get link node.
 	//
 	// acceptor_t saves conn_t in a doubly linked list.
@@ -141,6 +247,26 @@ public:
 		return &this->m_link;
 	}
 
+	// Timeout timer, its owner is the conn_t object.
+	timer_node_t* timer() {
+		return &this->m_timer;
+	}
+
+	// Get which timeout the timer is for (timer_???).
+	int timer_phase() const {
+		return this->m_timer_phase;
+	}
+
+	void timer_phase(int phase) {
+		this->m_timer_phase = phase;
+	}
+
+	// Set where AIO tasks are executed, and where they go after completed.
+	void aio(aio_pool_t* pool, aio_queue_t* queue) {
+		this->m_aio_pool = pool;
+		this->m_aio_queue = queue;
+	}
+
 	// There is an AIO task completed.
 	void on_aio_completed_i(conn_t::aio_node_t* aio_node);
 
@@ -176,26 +302,45 @@ private:
 	conn_t(const conn_t&) = delete;
 	conn_t& operator=(const conn_t&) = delete;
 
-public:
-	// AIO signal id.
-	static const int aio_signal_id;
+	// Submit an AIO task to aio_pool_t.
+	err_t aio_submit_i(bool write, fd_t fd, int64_t offset,
+		char* buf, size_t size, int64_t* id);
+
+	// Get raw address of peer side (getpeername() is called if needed).
+	//
+	// Return null if it's unknown.
+	const struct sockaddr_storage* peer() const;
 
 private:
-	std::string m_ip;
 	socket_t m_sd;
-	uint16_t m_port;
-	bool m_ipv6;
+
+	// Raw address of peer side, "ss_family" is AF_UNSPEC if it's unknown.
+	mutable struct sockaddr_storage m_addr;
+
+	// Formatted IP, it's empty if it's not formatted yet.
+	mutable std::string m_ip;
 	link_t<conn_t> m_link;
+	timer_node_t m_timer;
+	int m_timer_phase;
 	buf_t m_recv_buf;
 	buf_t m_send_buf;
-	size_t m_send_offset;
+	buf_t m_flight_buf;
+	send_chain_t m_send_chain;
+	send_chain_t m_flight_chain;
+	uring_state_t m_uring_state;
 	uint32_t m_last_event_result;
+	bool m_readable;
+	bool m_writable;
+	bool m_ready_state;
 	link_t<aio_node_t> m_aio_running;
 	link_t<aio_node_t> m_aio_completed;
 	int m_aio_running_count;
 	int m_aio_completed_count;
 	int64_t m_aio_sequence;
 	bool m_aio_wait_state;
+	aio_pool_t* m_aio_pool;
+	aio_queue_t* m_aio_queue;
+	void* m_owner;
 };
 
 
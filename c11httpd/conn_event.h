@@ -34,7 +34,19 @@ public:
 		//
 		// When this flag is on, acceptor_t will keep calling
 		// conn_event_t::get_more_data() until this flag becomes off.
-		result_more_data = (1 << 1)
+		result_more_data = (1 << 1),
+
+		// A request header was received, waiting for the rest of its body.
+		//
+		// acceptor_t uses config_t::body_timeout() instead of
+		// config_t::header_timeout() for this connection.
+		result_wait_body = (1 << 2),
+
+		// At least one request was completed.
+		//
+		// If the next request is already partially received (pipelining),
+		// acceptor_t restarts config_t::header_timeout() for it.
+		result_request_done = (1 << 3)
 	};
 
 public:
@@ -97,6 +109,15 @@ public:
 		conn_session_t& session,
 		buf_t& recv_buf, buf_t& send_buf) = 0;
 
+	// Create a context object in advance.
+	//
+	// It's called for each preallocated connection object (see
+	// config_t::prealloc_connections()), so the context object is also
+	// created at startup. Return null if the handler does not have any.
+	virtual ctx_t* new_ctx() {
+		return 0;
+	}
+
 	// Get more data to send.
 	//
 	// "send_buf" might have some data pending to send,
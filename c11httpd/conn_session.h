@@ -9,6 +9,7 @@
 #include "c11httpd/pre__.h"
 #include "c11httpd/err.h"
 #include "c11httpd/fd.h"
+#include "c11httpd/send_chain.h"
 #include <string>
 #include <vector>
 
@@ -41,6 +42,10 @@ public:
 	virtual uint16_t port() const = 0;
 	virtual bool ipv6() const = 0;
 
+	// Chain of data to send, used to send large payloads without copying
+	// them to the send buffer (see send_chain_t).
+	virtual send_chain_t& send_chain() = 0;
+
 	// AIO operations.
 	virtual err_t aio_read(fd_t fd, int64_t offset, char* buf, size_t size, int64_t* id = 0) = 0;
 	virtual err_t aio_write(fd_t fd, int64_t offset, const char* buf, size_t size, int64_t* id = 0) = 0;
@@ -153,6 +153,15 @@ private:
 };
 
 
+// Case-sensitive less operator for fast_str_t.
+class fast_str_less_t {
+public:
+	bool operator()(const fast_str_t& first, const fast_str_t& second) const {
+		return first.cmp(second) < 0;
+	}
+};
+
+
 // No-case less operator for fast_str_t.
 class fast_str_less_nocase_t {
 public:
@@ -14,6 +14,21 @@ void http_conn_t::clear() {
 	this->m_request.clear();
 	this->m_response.clear();
 	this->m_placeholders.clear();
+	this->route(http_router_t::find_result_t::not_found, 0, 0);
+}
+
+void http_conn_t::rebase(const char* recv_front) {
+	assert(recv_front != 0);
+
+	if (this->m_recv_front != 0 && this->m_recv_front != recv_front) {
+		for (auto& item : this->m_placeholders) {
+			if (item.c_str() != 0) {
+				item.set(recv_front + (item.c_str() - this->m_recv_front), item.length());
+			}
+		}
+	}
+
+	this->m_recv_front = recv_front;
 }
 
 
@@ -12,6 +12,7 @@
 #include "c11httpd/fast_str.h"
 #include "c11httpd/http_request.h"
 #include "c11httpd/http_response.h"
+#include "c11httpd/http_router.h"
 #include <vector>
 
 
@@ -21,7 +22,9 @@ namespace c11httpd {
 // HTTP connection.
 class http_conn_t : public ctx_t, public ctx_setter_t {
 public:
-	http_conn_t() = default;
+	http_conn_t() : m_find_result(http_router_t::find_result_t::not_found),
+		m_api(0), m_recv_front(0) {
+	}
 	virtual ~http_conn_t() = default;
 
 	// Clear content.
@@ -42,10 +45,37 @@ public:
 		return this->m_placeholders;
 	}
 
+	// Result of finding API of current request.
+	http_router_t::find_result_t find_result() const {
+		return this->m_find_result;
+	}
+
+	// API of current request (it's valid if find_result() is ok).
+	const rest_ctrl_t::api_t* api() const {
+		return this->m_api;
+	}
+
+	// Save route of current request. Placeholders point to "recv_front".
+	void route(http_router_t::find_result_t find_result,
+		const rest_ctrl_t::api_t* api, const char* recv_front) {
+		this->m_find_result = find_result;
+		this->m_api = api;
+		this->m_recv_front = recv_front;
+	}
+
+	// Receive buffer might have been re-allocated since current request
+	// was routed (e.g. while receiving body), update placeholders.
+	void rebase(const char* recv_front);
+
 private:
 	http_request_t m_request;
 	http_response_t m_response;
 	std::vector<fast_str_t> m_placeholders;
+
+	// Route of current request.
+	http_router_t::find_result_t m_find_result;
+	const rest_ctrl_t::api_t* m_api;
+	const char* m_recv_front;
 };
 
 
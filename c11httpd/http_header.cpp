@@ -25,6 +25,7 @@ const fast_str_t http_header_t::App_ZIP = "application/zip";
 const fast_str_t http_header_t::Attachment = "attachment";
 const fast_str_t http_header_t::Authorization = "Authorization";
 const fast_str_t http_header_t::Bytes = "bytes";
+const fast_str_t http_header_t::Chunked = "chunked";
 const fast_str_t http_header_t::Compress = "compress";
 const fast_str_t http_header_t::Connection = "Connection";
 
@@ -39,11 +40,14 @@ const fast_str_t http_header_t::Content_Type = "Content-Type";
 
 const fast_str_t http_header_t::Date = "Date";
 const fast_str_t http_header_t::Deflate = "deflate";
+const fast_str_t http_header_t::ETag = "ETag";
 const fast_str_t http_header_t::Filename = "filename";
 const fast_str_t http_header_t::GZIP = "gzip";
 const fast_str_t http_header_t::Host = "Host";
 const fast_str_t http_header_t::HTTP_VERSION_1_1 = "HTTP/1.1";
 const fast_str_t http_header_t::Identify = "identify";
+const fast_str_t http_header_t::If_Modified_Since = "If-Modified-Since";
+const fast_str_t http_header_t::If_None_Match = "If-None-Match";
 const fast_str_t http_header_t::Image_GIF = "image/gif";
 const fast_str_t http_header_t::Image_JPEG = "image/jpeg";
 const fast_str_t http_header_t::Image_PNG = "image/png";
@@ -56,12 +60,121 @@ const fast_str_t http_header_t::Text_CSS_UTF8 = "text/css; charset=UTF-8";
 const fast_str_t http_header_t::Text_HTML_UTF8 = "text/html; charset=UTF-8";
 const fast_str_t http_header_t::Text_JavaScript = "text/javascript";
 const fast_str_t http_header_t::Text_Plain_UTF8 = "text/plain; charset=UTF-8";
+const fast_str_t http_header_t::Transfer_Encoding = "Transfer-Encoding";
 
 
 // Single instance.
 http_header_t::all http_header_t::all::st_instance;
 
 
+namespace {
+
+// Names of well-known request headers, in order of http_header_t::known_t.
+constexpr const char* st_known_names[] = {
+	"Accept",
+	"Accept-Charset",
+	"Accept-Encoding",
+	"Accept-Language",
+	"Authorization",
+	"Cache-Control",
+	"Connection",
+	"Content-Encoding",
+	"Content-Length",
+	"Content-Type",
+	"Cookie",
+	"Expect",
+	"Host",
+	"If-Modified-Since",
+	"If-None-Match",
+	"Origin",
+	"Pragma",
+	"Range",
+	"Referer",
+	"Transfer-Encoding",
+	"Upgrade",
+	"User-Agent",
+	"X-Forwarded-For"
+};
+
+constexpr size_t known_names = sizeof(st_known_names) / sizeof(st_known_names[0]);
+constexpr unsigned known_slots = 64;
+
+static_assert(known_names == http_header_t::known_count,
+	"Names do not match http_header_t::known_t");
+
+constexpr size_t strlen_i(const char* str) {
+	return *str == 0 ? 0 : 1 + strlen_i(str + 1);
+}
+
+constexpr unsigned lower_i(char ch) {
+	return (ch >= 'A' && ch <= 'Z') ? unsigned(ch - 'A' + 'a') : unsigned((unsigned char) ch);
+}
+
+// Length, first, middle and last characters (case insensitive).
+constexpr unsigned hash_i(const char* str, size_t len) {
+	return unsigned(len + 2 * lower_i(str[0]) + 3 * lower_i(str[len - 1])
+		+ 2 * lower_i(str[len / 2])) % known_slots;
+}
+
+constexpr unsigned known_hash_i(size_t index) {
+	return hash_i(st_known_names[index], strlen_i(st_known_names[index]));
+}
+
+constexpr bool unique_with_i(size_t index, size_t another) {
+	return another >= known_names ? true
+		: (known_hash_i(index) != known_hash_i(another) && unique_with_i(index, another + 1));
+}
+
+constexpr bool unique_i(size_t index) {
+	return index >= known_names ? true
+		: (unique_with_i(index, index + 1) && unique_i(index + 1));
+}
+
+static_assert(unique_i(0), "Hash of well-known headers is not perfect, please adjust hash_i()");
+
+// Slot -> index of well-known header (or -1).
+class known_table_t {
+public:
+	known_table_t() {
+		for (unsigned i = 0; i < known_slots; ++i) {
+			this->m_slots[i] = -1;
+		}
+
+		for (size_t i = 0; i < known_names; ++i) {
+			this->m_names[i] = st_known_names[i];
+			this->m_slots[known_hash_i(i)] = int8_t(i);
+		}
+	}
+
+	int8_t m_slots[known_slots];
+	fast_str_t m_names[known_names];
+};
+
+const known_table_t st_known_table;
+
+} // namespace.
+
+
+int http_header_t::known(const fast_str_t& key) {
+	if (key.empty()) {
+		return -1;
+	}
+
+	const int index = st_known_table.m_slots[hash_i(key.c_str(), key.length())];
+	if (index >= 0 && key.cmpi(st_known_table.m_names[index]) == 0) {
+		return index;
+	}
+
+	return -1;
+}
+
+const fast_str_t& http_header_t::known_name(int index) {
+	assert(index >= 0 && index < known_count);
+
+	return st_known_table.m_names[index];
+}
+
+
 http_header_t::all::all() {
 	// Common fields.
 	const std::vector<fast_str_t> common = {
@@ -59,6 +59,35 @@ public:
 		fast_str_less_nocase_t m_less;
 	};
 
+public:
+	// Well-known request headers, which are indexed by http_request_t.
+	enum known_t {
+		known_accept = 0,
+		known_accept_charset,
+		known_accept_encoding,
+		known_accept_language,
+		known_authorization,
+		known_cache_control,
+		known_connection,
+		known_content_encoding,
+		known_content_length,
+		known_content_type,
+		known_cookie,
+		known_expect,
+		known_host,
+		known_if_modified_since,
+		known_if_none_match,
+		known_origin,
+		known_pragma,
+		known_range,
+		known_referer,
+		known_transfer_encoding,
+		known_upgrade,
+		known_user_agent,
+		known_x_forwarded_for,
+		known_count
+	};
+
 public:
 	static const fast_str_t Accept;
 	static const fast_str_t Accept_Charset;
@@ -75,6 +104,7 @@ public:
 	static const fast_str_t Attachment;
 	static const fast_str_t Authorization;
 	static const fast_str_t Bytes;
+	static const fast_str_t Chunked;
 	static const fast_str_t Compress;
 	static const fast_str_t Connection;
 	static const fast_str_t Content_Encoding;
@@ -89,11 +119,14 @@ public:
 	static const fast_str_t Content_Type;
 	static const fast_str_t Date;
 	static const fast_str_t Deflate;
+	static const fast_str_t ETag;
 	static const fast_str_t Filename;
 	static const fast_str_t GZIP;
 	static const fast_str_t Host;
 	static const fast_str_t HTTP_VERSION_1_1;
 	static const fast_str_t Identify;
+	static const fast_str_t If_Modified_Since;
+	static const fast_str_t If_None_Match;
 	static const fast_str_t Image_GIF;
 	static const fast_str_t Image_JPEG;
 	static const fast_str_t Image_PNG;
@@ -106,6 +139,18 @@ public:
 	static const fast_str_t Text_HTML_UTF8;
 	static const fast_str_t Text_JavaScript;
 	static const fast_str_t Text_Plain_UTF8;
+	static const fast_str_t Transfer_Encoding;
+
+public:
+	// Get index (known_???) of a well-known request header (case insensitive).
+	//
+	// Names are indexed by a perfect hash (checked at compile time),
+	// so it costs one hash and at most one string comparison.
+	// Return -1 if it's not a well-known header.
+	static int known(const fast_str_t& key);
+
+	// Get name of a well-known request header.
+	static const fast_str_t& known_name(int index);
 
 public:
 	http_header_t() = default;
@@ -29,45 +29,81 @@ uint32_t http_processor_t::on_received(
 
 	// Create a new HTTP session object if it's not created.
 	if (ctx_setter.ctx() == 0) {
-		ctx_setter.ctx(new http_conn_t());
+		ctx_setter.ctx(this->new_ctx());
 	}
 
 	// Get the HTTP session object.
 	auto http_conn = (http_conn_t*) ctx_setter.ctx();
-
-	// Parse HTTP request.
-	size_t request_bytes;
-	const auto parse_result = http_conn->request().continue_to_parse(&recv_buf, &request_bytes);
-
-	// HTTP request is not fully received, wait for next TCP packet.
-	if (parse_result == http_request_t::parse_result_t::more) {
-		return 0;
+	uint32_t event_result = 0;
+
+	// A client might send several requests without waiting for responses
+	// (HTTP/1.1 pipelining), so process all complete requests in "recv_buf".
+	// Responses are appended to "send_buf" in order and sent in one batch.
+	while (recv_buf.size() > 0) {
+		// Parse HTTP request.
+		size_t request_bytes;
+		const auto parse_result = http_conn->request().continue_to_parse(cfg, &recv_buf, &request_bytes);
+
+		// Request header was parsed, find the API before receiving body,
+		// because it decides whether body is received chunk by chunk.
+		if (parse_result == http_request_t::parse_result_t::header) {
+			this->route_i(http_conn, recv_buf.front());
+			continue;
+		}
+
+		// HTTP request is not fully received, wait for next TCP packet.
+		if (parse_result == http_request_t::parse_result_t::more) {
+			if (http_conn->request().header_done()) {
+				return event_result | conn_event_t::result_wait_body;
+			}
+
+			break;
+		}
+
+		// HTTP request is incorrect, let's close the connection
+		// after responses of previous requests are sent.
+		if (parse_result == http_request_t::parse_result_t::failed) {
+			return conn_event_t::result_disconnect;
+		}
+
+		// Pass body chunk to the API, it's removed from "recv_buf"
+		// by next call to continue_to_parse().
+		if (http_conn->request().stream_body()) {
+			if (this->body_i(session, http_conn, recv_buf.front()) == rest_result_t::abandon) {
+				return conn_event_t::result_disconnect;
+			}
+
+			if (parse_result == http_request_t::parse_result_t::chunk) {
+				continue;
+			}
+		}
+
+		// Save the original size of "send_buf" (and send chain).
+		const auto old_size = send_buf.size();
+		const auto old_count = session.send_chain().count();
+
+		// Placeholders point to "recv_buf", which might have been re-allocated.
+		http_conn->rebase(recv_buf.front());
+
+		// Process this request.
+		const auto result = this->process_i(cfg, session, http_conn, &send_buf);
+
+		// If fatal error happens, then restore original size of "send_buf".
+		if (result == rest_result_t::abandon) {
+			session.send_chain().rollback(old_count);
+			send_buf.size(old_size);
+			return conn_event_t::result_disconnect;
+		}
+
+		// We have processed this request, remove it from beginning of the buffer
+		// (no memory is copied). Because "request" has some fast_str_t point to
+		// the recv buffer, we need to clear "request" first.
+		http_conn->request().clear();
+		recv_buf.erase_front(request_bytes);
+		event_result |= conn_event_t::result_request_done;
 	}
 
-	// HTTP request is incorrect, let's close the connection.
-	if (parse_result == http_request_t::parse_result_t::failed) {
-		return conn_event_t::result_disconnect;
-	}
-
-	// Save the original size of "send_buf".
-	const auto old_size = send_buf.size();
-
-	// Process this request.
-	const auto result = this->process_i(cfg, session, http_conn, &send_buf);
-
-	// If fatal error happens, then restore original size of "send_buf".
-	if (result == rest_result_t::abandon) {
-		send_buf.size(old_size);
-		return conn_event_t::result_disconnect;
-	}
-
-	// We have processed this request, remove it from beginning of the buffer.
-	// Because "request" has some fast_str_t point to the recv buffer,
-	// we need to clear "request" first.
-	http_conn->request().clear();
-	recv_buf.erase_front(request_bytes);
-
-	return 0;
+	return event_result;
 }
 
 rest_result_t http_processor_t::process_i(
@@ -75,23 +111,80 @@ rest_result_t http_processor_t::process_i(
 	http_conn_t* http_conn, buf_t* send_buf) {
 	assert(http_conn != 0);
 
-	rest_ctrl_t* controller = *(this->m_controllers.begin());
-	const rest_ctrl_t::api_t& api = *(controller->apis().begin());
+	const auto& request = http_conn->request();
+	const auto find_result = http_conn->find_result();
+	const rest_ctrl_t::api_t* const api = http_conn->api();
+	auto& placeholders = http_conn->placeholders();
+
+	if (find_result != http_router_t::find_result_t::ok) {
+		http_conn->response().attach(&cfg, &request, 0, send_buf, &session.send_chain());
+		http_conn->response().code(
+			find_result == http_router_t::find_result_t::not_found
+			? http_status_t::not_found : http_status_t::method_not_allowed);
+		http_conn->response().detach(rest_result_t::done);
+
+		return rest_result_t::done;
+	}
 
 	// Attach response object to send_buf.
 	http_conn->response().attach(&cfg,
-		&(http_conn->request()), &(std::get<4>(api)), send_buf);
+		&request, &(std::get<4>(*api)), send_buf, &session.send_chain());
 
-	const auto result = std::get<2>(api)->invoke(*http_conn, session,
-		http_conn->request(), std::vector<fast_str_t>(),
-		http_conn->response());
+	const auto result = std::get<2>(*api)->invoke(*http_conn, session,
+		request, placeholders, http_conn->response());
 
 	// Detach response object from send_buf.
 	http_conn->response().detach(result);
 
+	// Placeholders point to recv buffer, so clear them.
+	placeholders.clear();
+
 	return result;
 }
 
+void http_processor_t::route_i(http_conn_t* http_conn, const char* recv_front) {
+	assert(http_conn != 0);
+
+	const rest_ctrl_t::api_t* api = 0;
+	auto& request = http_conn->request();
+	auto& placeholders = http_conn->placeholders();
+
+	placeholders.clear();
+	const auto find_result = this->m_router.find(request.hostname(),
+		request.method(), request.uri(), &placeholders, &api);
+
+	http_conn->route(find_result, api, recv_front);
+
+	// Receive body chunk by chunk if the API has a body routine.
+	if (find_result == http_router_t::find_result_t::ok && std::get<5>(*api)) {
+		request.stream_body(true);
+	}
+}
+
+rest_result_t http_processor_t::body_i(conn_session_t& session,
+	http_conn_t* http_conn, const char* recv_front) {
+	assert(http_conn != 0);
+
+	const auto& request = http_conn->request();
+
+	if (request.chunk().empty()) {
+		return rest_result_t::done;
+	}
+
+	http_conn->rebase(recv_front);
+
+	return std::get<5>(*http_conn->api())->invoke(*http_conn, session,
+		request, http_conn->placeholders(), request.chunk());
+}
+
+ctx_t* http_processor_t::new_ctx() {
+	auto http_conn = new http_conn_t();
+
+	// Routing would not allocate memory for placeholders.
+	http_conn->placeholders().reserve(this->m_router.max_placeholders());
+	return http_conn;
+}
+
 uint32_t http_processor_t::get_more_data(
 	ctx_setter_t& ctx_setter, const config_t& cfg,
 	conn_session_t& session, buf_t& send_buf) {
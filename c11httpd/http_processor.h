@@ -10,6 +10,7 @@
 #include "c11httpd/config.h"
 #include "c11httpd/conn_event.h"
 #include "c11httpd/http_conn.h"
+#include "c11httpd/http_router.h"
 #include "c11httpd/rest_ctrl.h"
 #include <vector>
 
@@ -21,11 +22,13 @@ namespace c11httpd {
 //
 // This class does following:
 // -# Parse HTTP request header and content.
-// -# Distribute request to the right controller based on URI.
+// -# Distribute request to the right controller based on
+//    virtual host, URI and method.
 class http_processor_t : public conn_event_t {
 public:
 	explicit http_processor_t(const std::vector<rest_ctrl_t*>& controllers)
 		: m_controllers(controllers) {
+		this->m_router.build(this->m_controllers);
 	}
 	virtual ~http_processor_t() = default;
 
@@ -43,6 +46,8 @@ public:
 		conn_session_t& session,
 		buf_t& recv_buf, buf_t& send_buf);
 
+	virtual ctx_t* new_ctx();
+
 	virtual uint32_t get_more_data(
 		ctx_setter_t& ctx_setter, const config_t& cfg,
 		conn_session_t& session,
@@ -63,8 +68,16 @@ private:
 		const config_t& cfg, conn_session_t& session,
 		http_conn_t* http_conn, buf_t* send_buf);
 
+	// Find the API of a request whose header was just parsed.
+	void route_i(http_conn_t* http_conn, const char* recv_front);
+
+	// Pass a body chunk to the API (streaming mode).
+	rest_result_t body_i(conn_session_t& session,
+		http_conn_t* http_conn, const char* recv_front);
+
 private:
 	const std::vector<rest_ctrl_t*> m_controllers;
+	http_router_t m_router;
 };
 
 
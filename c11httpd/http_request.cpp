@@ -5,6 +5,8 @@
  */
 
 #include "c11httpd/http_request.h"
+#include "c11httpd/scan.h"
+#include <cstring>
 
 
 namespace c11httpd {
@@ -15,8 +17,20 @@ http_request_t::http_request_t() {
 	this->m_method = http_method_t::unknown;
 	this->m_content = 0;
 	this->m_content_length = 0;
+	this->m_stream_body = false;
+	this->m_chunked = false;
+	this->m_chunk_state = chunk_size;
+	this->m_chunk_left = 0;
+	this->m_body_bytes = 0;
+	this->m_decoded_bytes = 0;
+	this->m_raw_bytes = 0;
 	this->m_processed_bytes = 0;
+	this->m_scanned_bytes = 0;
 	this->m_step = step_initial;
+
+	for (int i = 0; i < http_header_t::known_count; ++i) {
+		this->m_known[i] = -1;
+	}
 }
 
 // Clear content but do not free buffer.
@@ -30,9 +44,22 @@ void http_request_t::clear() {
 	this->m_headers.clear();
 	this->m_content = 0;
 	this->m_content_length = 0;
+	this->m_stream_body = false;
+	this->m_chunked = false;
+	this->m_chunk_state = chunk_size;
+	this->m_chunk_left = 0;
+	this->m_body_bytes = 0;
+	this->m_decoded_bytes = 0;
+	this->m_raw_bytes = 0;
+	this->m_chunk.clear();
 	this->m_processed_bytes = 0;
+	this->m_scanned_bytes = 0;
 	this->m_step = step_initial;
 	this->m_split_items.clear();
+
+	for (int i = 0; i < http_header_t::known_count; ++i) {
+		this->m_known[i] = -1;
+	}
 }
 
 const fast_str_t* http_request_t::var(const fast_str_t& name) const {
@@ -54,21 +81,22 @@ const fast_str_t* http_request_t::var(const fast_str_t& name) const {
 const fast_str_t* http_request_t::header(const fast_str_t& key) const {
 	assert(!key.empty());
 
-	const http_header_t val(key, fast_str_t());
-	const auto it = std::lower_bound(
-			this->m_headers.cbegin(),
-			this->m_headers.cend(),
-			val);
+	const int known = http_header_t::known(key);
+	if (known >= 0) {
+		return this->header(http_header_t::known_t(known));
+	}
 
-	if (it != this->m_headers.cend() && !(val < (*it))) {
-		return &((*it).value());
-	} else {
-		return 0;
+	for (const auto& item : this->m_headers) {
+		if (item.key().cmpi(key) == 0) {
+			return &(item.value());
+		}
 	}
+
+	return 0;
 }
 
 http_request_t::parse_result_t http_request_t::continue_to_parse(
-	const buf_t* recv_buf, size_t* bytes) {
+	const config_t& cfg, buf_t* recv_buf, size_t* bytes) {
 	assert(recv_buf != 0);
 	assert(recv_buf->size() >= this->m_processed_bytes);
 	assert(bytes != 0);
@@ -100,7 +128,8 @@ http_request_t::parse_result_t http_request_t::continue_to_parse(
 		}
 
 		if (next_result == next_line_t::more) {
-			return parse_result_t::more;
+			return recv_buf->size() > size_t(cfg.max_header_size())
+				? parse_result_t::failed : parse_result_t::more;
 		}
 
 		if (line.split(" \t", &this->m_split_items) != 3) {
@@ -182,54 +211,117 @@ http_request_t::parse_result_t http_request_t::continue_to_parse(
 			}
 
 			if (next_result == next_line_t::more) {
-				return parse_result_t::more;
+				return recv_buf->size() > size_t(cfg.max_header_size())
+					? parse_result_t::failed : parse_result_t::more;
 			}
 
 			// Parsing header is done.
 			if (line.empty() && crlf) {
 				this->m_processed_bytes = size_t(msg.c_str() - this->m_recv_buf);
+
+				if (this->m_processed_bytes > size_t(cfg.max_header_size())) {
+					return parse_result_t::failed;
+				}
+
+				// Content length.
+				const fast_str_t* len_str = this->header(http_header_t::known_content_length);
+				if (len_str != 0 && !parse_length_i(*len_str, &this->m_content_length)) {
+					return parse_result_t::failed;
+				}
+
+				// Only a single "chunked" transfer-encoding is supported, a list
+				// (e.g. "gzip, chunked" or "chunked, chunked") is rejected. It's also
+				// rejected if "Content-Length" is present (to avoid request smuggling).
+				const fast_str_t* encoding = this->header(http_header_t::known_transfer_encoding);
+				if (encoding != 0) {
+					if (len_str != 0 || encoding->cmpi(http_header_t::Chunked) != 0) {
+						return parse_result_t::failed;
+					}
+
+					this->m_chunked = true;
+				}
+
+				this->m_raw_bytes = this->m_processed_bytes;
+
+				// Let caller decide how to receive body.
 				this->m_step = step_header_done;
-				std::sort(this->m_headers.begin(), this->m_headers.end());
-				break;
+				*bytes = this->m_processed_bytes;
+				return parse_result_t::header;
 			}
 
 			if (!split_header_line_i(line, &key, &value)) {
 				return parse_result_t::failed;
 			}
 
-			m_headers.push_back(http_header_t(key, value));
-			this->m_processed_bytes = size_t(msg.c_str() - this->m_recv_buf);
+			// Index well-known headers (the first one wins).
+			const int known = http_header_t::known(key);
 
-			// Host name.
-			if (this->m_hostname.empty() && key.cmpi(http_header_t::Host) == 0) {
-				this->m_hostname = value.before(':');
+			// Body framing must be unambiguous (to avoid request smuggling):
+			// "Transfer-Encoding" must not be repeated, and repeated
+			// "Content-Length" must have the same value.
+			if (known >= 0 && this->m_known[known] >= 0) {
+				if (known == http_header_t::known_transfer_encoding) {
+					return parse_result_t::failed;
+				}
+
+				if (known == http_header_t::known_content_length
+					&& value != this->m_headers[this->m_known[known]].value()) {
+					return parse_result_t::failed;
+				}
 			}
+
+			if (known >= 0 && this->m_known[known] < 0) {
+				this->m_known[known] = int(this->m_headers.size());
+
+				// Host name.
+				if (known == http_header_t::known_host) {
+					this->m_hostname = value.before(':');
+				}
+			}
+
+			m_headers.push_back(http_header_t(key, value));
+			this->m_processed_bytes = size_t(msg.c_str() - this->m_recv_buf);
 		}
 	}
 
 	if (this->m_step < step_content_done) {
-		if (this->m_content_length == 0) {
-			const fast_str_t* len_str = this->header(http_header_t::Content_Length);
+		// The last body chunk has been processed by caller (streaming mode).
+		if (this->m_stream_body && this->m_decoded_bytes > 0) {
+			this->m_decoded_bytes = 0;
+			this->m_chunk.clear();
+			this->compact_i(recv_buf);
+		}
+
+		if (this->m_chunked) {
+			if (!this->decode_chunked_i(cfg, recv_buf)) {
+				return parse_result_t::failed;
+			}
+		} else {
+			if (!this->decode_length_i(cfg, recv_buf)) {
+				return parse_result_t::failed;
+			}
+		}
 
-			if (len_str != 0 && !len_str->empty()) {
-				int32_t n;
+		const bool done = this->m_chunked
+			? this->m_chunk_state == chunk_done
+			: this->m_body_bytes == this->m_content_length;
 
-				if (!len_str->to_number(&n)
-					|| n < 0
-					|| n > 10 * 1024 * 1024) {
-					return parse_result_t::failed;
-				}
+		if (this->m_stream_body) {
+			this->m_chunk.set(this->m_recv_buf + this->m_processed_bytes, this->m_decoded_bytes);
 
-				this->m_content_length = size_t(n);
+			if (!done) {
+				return this->m_decoded_bytes > 0 ? parse_result_t::chunk : parse_result_t::more;
+			}
+		} else {
+			if (!done) {
+				return parse_result_t::more;
 			}
-		}
 
-		if (this->m_processed_bytes + this->m_content_length > recv_buf->size() ) {
-			return parse_result_t::more;
+			this->m_content = this->m_recv_buf + this->m_processed_bytes;
 		}
 
-		m_content = this->m_recv_buf + this->m_processed_bytes;
-		this->m_processed_bytes += this->m_content_length;
+		this->m_content_length = this->m_body_bytes;
+		this->m_processed_bytes = this->m_raw_bytes;
 		this->m_step = step_content_done;
 	}
 
@@ -243,26 +335,36 @@ http_request_t::next_line_t http_request_t::next_line_i(
 	assert(line != 0);
 	assert(crlf != 0);
 
-	for (size_t i = 0; i < msg->length(); ++i) {
-		if (msg->at(i) == 0) {
-			return next_line_t::failed;
-		}
+	const char* const begin = msg->c_str();
+	const char* const end = begin + msg->length();
 
-		if (msg->at(i) == '\n') {
-			if (i > 0 && msg->at(i - 1) == '\r') {
-				*crlf = true;
-				line->set(msg->c_str(), i - 1);
-			} else {
-				*crlf = false;
-				line->set(msg->c_str(), i);
-			}
+	// Skip bytes scanned last time.
+	const char* from = this->m_recv_buf + this->m_scanned_bytes;
+	if (from < begin) {
+		from = begin;
+	}
 
-			*msg = msg->substr(i + 1);
-			return next_line_t::ok;
-		}
+	// A null terminal character before new-line character is an error.
+	const char* const pos = scan_t::find(from, end, '\n', 0);
+	if (pos == end) {
+		this->m_scanned_bytes = size_t(end - this->m_recv_buf);
+		return next_line_t::more;
+	}
+
+	if (*pos == 0) {
+		return next_line_t::failed;
 	}
 
-	return next_line_t::more;
+	if (pos > begin && pos[-1] == '\r') {
+		*crlf = true;
+		line->set(begin, pos - begin - 1);
+	} else {
+		*crlf = false;
+		line->set(begin, pos - begin);
+	}
+
+	msg->set(pos + 1, end - pos - 1);
+	return next_line_t::ok;
 }
 
 bool http_request_t::split_header_line_i(
@@ -270,11 +372,14 @@ bool http_request_t::split_header_line_i(
 	assert(key != 0);
 	assert(value != 0);
 
-	const auto pos = line.find_first_of(':');
-	if (pos == 0 || pos == fast_str_t::npos || pos == line.length() - 1) {
+	const char* const end = line.c_str() + line.length();
+	const char* const colon = scan_t::find(line.c_str(), end, ':', ':');
+	if (colon == line.c_str() || colon == end || colon == end - 1) {
 		return false;
 	}
 
+	const size_t pos = size_t(colon - line.c_str());
+
 	key->set(line.c_str(), pos);
 	value->set(line.c_str() + pos + 1, line.length() - pos - 1);
 
@@ -288,24 +393,241 @@ bool http_request_t::split_header_line_i(
 	return true;
 }
 
+bool http_request_t::parse_length_i(const fast_str_t& str, size_t* value) {
+	assert(value != 0);
+
+	size_t n = 0;
+
+	if (str.empty()) {
+		return false;
+	}
+
+	for (size_t i = 0; i < str.length(); ++i) {
+		const char ch = str[i];
+
+		if (ch < '0' || ch > '9' || n > (SIZE_MAX - size_t(ch - '0')) / 10) {
+			return false;
+		}
+
+		n = n * 10 + size_t(ch - '0');
+	}
+
+	*value = n;
+	return true;
+}
+
+bool http_request_t::parse_chunk_size_i(const fast_str_t& line, size_t* value) {
+	assert(value != 0);
+
+	size_t n = 0;
+	size_t i = 0;
+
+	for (; i < line.length(); ++i) {
+		const char ch = line[i];
+		size_t digit;
+
+		if (ch >= '0' && ch <= '9') {
+			digit = size_t(ch - '0');
+		} else if (ch >= 'a' && ch <= 'f') {
+			digit = size_t(ch - 'a' + 10);
+		} else if (ch >= 'A' && ch <= 'F') {
+			digit = size_t(ch - 'A' + 10);
+		} else {
+			break;
+		}
+
+		if (n > (SIZE_MAX >> 4)) {
+			return false;
+		}
+
+		n = (n << 4) | digit;
+	}
+
+	if (i == 0) {
+		return false;
+	}
+
+	// Chunk extensions (e.g. ";name=value") are ignored.
+	while (i < line.length() && (line[i] == ' ' || line[i] == '\t')) {
+		++i;
+	}
+
+	if (i < line.length() && line[i] != ';') {
+		return false;
+	}
+
+	*value = n;
+	return true;
+}
+
+bool http_request_t::decode_length_i(const config_t& cfg, const buf_t* recv_buf) {
+	assert(recv_buf != 0);
+
+	// Body is received as a whole, it must not be too big.
+	if (!this->m_stream_body && this->m_content_length > uint64_t(cfg.max_body_size())) {
+		return false;
+	}
+
+	// Body is not encoded, so it's already in place.
+	const size_t n = std::min(recv_buf->size() - this->m_raw_bytes,
+		this->m_content_length - this->m_body_bytes);
+
+	this->m_body_bytes += n;
+	this->m_decoded_bytes += n;
+	this->m_raw_bytes += n;
+
+	return true;
+}
+
+bool http_request_t::decode_chunked_i(const config_t& cfg, buf_t* recv_buf) {
+	assert(recv_buf != 0);
+
+	char* const body = recv_buf->front() + this->m_processed_bytes;
+	const char* const end = recv_buf->front() + recv_buf->size();
+	const size_t max_line = size_t(cfg.max_header_size());
+	fast_str_t line;
+	bool crlf;
+
+	while (this->m_chunk_state != chunk_done) {
+		const char* const raw = recv_buf->front() + this->m_raw_bytes;
+
+		if (this->m_chunk_state == chunk_data) {
+			const size_t n = std::min(this->m_chunk_left, size_t(end - raw));
+			if (n == 0) {
+				break;
+			}
+
+			// Move chunk data to follow decoded body.
+			char* const dest = body + this->m_decoded_bytes;
+			if (dest != raw) {
+				std::memmove(dest, raw, n);
+			}
+
+			this->m_chunk_left -= n;
+			this->m_body_bytes += n;
+			this->m_decoded_bytes += n;
+			this->m_raw_bytes += n;
+
+			if (this->m_chunk_left == 0) {
+				this->m_chunk_state = chunk_data_end;
+			}
+
+			continue;
+		}
+
+		// Chunk size line, CRLF after chunk data, or trailer.
+		fast_str_t msg(raw, size_t(end - raw));
+		const auto next_result = this->next_line_i(&msg, &line, &crlf);
+
+		if (next_result == next_line_t::failed) {
+			return false;
+		}
+
+		if (next_result == next_line_t::more) {
+			if (size_t(end - raw) > max_line) {
+				return false;
+			}
+
+			break;
+		}
+
+		this->m_raw_bytes = size_t(msg.c_str() - recv_buf->front());
+
+		switch (this->m_chunk_state) {
+		case chunk_size:
+			if (!parse_chunk_size_i(line, &this->m_chunk_left)) {
+				return false;
+			}
+
+			// Body is received as a whole, it must not be too big.
+			if (!this->m_stream_body
+				&& this->m_chunk_left > uint64_t(cfg.max_body_size()) - this->m_body_bytes) {
+				return false;
+			}
+
+			this->m_chunk_state = (this->m_chunk_left > 0) ? chunk_data : chunk_trailer;
+			break;
+
+		case chunk_data_end:
+			if (!line.empty()) {
+				return false;
+			}
+
+			this->m_chunk_state = chunk_size;
+			break;
+
+		default:
+			// Trailer fields are ignored, but they must not be too big.
+			if (line.empty()) {
+				this->m_chunk_state = chunk_done;
+			} else {
+				this->m_chunk_left += line.length();
+
+				if (this->m_chunk_left > max_line) {
+					return false;
+				}
+			}
+			break;
+		}
+	}
+
+	// Remove chunk framing received so far. In streaming mode,
+	// it's removed together with body chunk after it's processed.
+	if (!this->m_stream_body && this->m_chunk_state != chunk_done) {
+		this->compact_i(recv_buf);
+	}
+
+	return true;
+}
+
+void http_request_t::compact_i(buf_t* recv_buf) {
+	assert(recv_buf != 0);
+	assert(this->m_raw_bytes <= recv_buf->size());
+
+	const size_t to = this->m_processed_bytes + this->m_decoded_bytes;
+	const size_t from = this->m_raw_bytes;
+	const size_t rest = recv_buf->size() - from;
+
+	assert(to <= from);
+	if (to == from) {
+		return;
+	}
+
+	if (rest > 0) {
+		std::memmove(recv_buf->front() + to, recv_buf->front() + from, rest);
+	}
+
+	recv_buf->size(to + rest);
+	this->m_raw_bytes = to;
+
+	// Bytes that have been scanned for new-line character are moved too.
+	this->m_scanned_bytes = (this->m_scanned_bytes > from)
+		? this->m_scanned_bytes - (from - to) : to;
+}
+
 void http_request_t::update_all_fast_str_i(const char* old_recv_buf, const char* new_recv_buf) {
 	assert(old_recv_buf != 0);
 	assert(new_recv_buf != 0);
 
-	if (this->m_step >= step_uri_done) {
-		update_single_fast_str_i(&this->m_uri, old_recv_buf, new_recv_buf);
-		update_single_fast_str_i(&this->m_http_version, old_recv_buf, new_recv_buf);
-	} else {
+	if (this->m_step < step_uri_done) {
 		return;
 	}
 
-	if (this->m_step >= step_header_done) {
-		for (decltype(this->m_headers.size()) i = 0; i < this->m_headers.size(); ++i) {
-			update_single_fast_str_i(&(this->m_headers[i].key()), old_recv_buf, new_recv_buf);
-			update_single_fast_str_i(&(this->m_headers[i].value()), old_recv_buf, new_recv_buf);
-		}
-	} else {
-		return;
+	update_single_fast_str_i(&this->m_uri, old_recv_buf, new_recv_buf);
+	update_single_fast_str_i(&this->m_http_version, old_recv_buf, new_recv_buf);
+
+	for (auto& item : this->m_vars) {
+		update_single_fast_str_i(&(item.name()), old_recv_buf, new_recv_buf);
+		update_single_fast_str_i(&(item.value()), old_recv_buf, new_recv_buf);
+	}
+
+	// Headers are parsed one by one, some of them
+	// might have been parsed even if step is not "header_done".
+	update_single_fast_str_i(&this->m_hostname, old_recv_buf, new_recv_buf);
+
+	for (auto& item : this->m_headers) {
+		update_single_fast_str_i(&(item.key()), old_recv_buf, new_recv_buf);
+		update_single_fast_str_i(&(item.value()), old_recv_buf, new_recv_buf);
 	}
 }
 
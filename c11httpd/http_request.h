@@ -8,6 +8,7 @@
 
 #include "c11httpd/pre__.h"
 #include "c11httpd/buf.h"
+#include "c11httpd/config.h"
 #include "c11httpd/fast_str.h"
 #include "c11httpd/http_header.h"
 #include "c11httpd/http_method.h"
@@ -30,10 +31,18 @@ public:
 		: m_name(name), m_value(value) {
 	}
 
+	fast_str_t& name() {
+		return this->m_name;
+	}
+
 	const fast_str_t& name() const {
 		return this->m_name;
 	}
 
+	fast_str_t& value() {
+		return this->m_value;
+	}
+
 	const fast_str_t& value() const {
 		return this->m_value;
 	}
@@ -66,6 +75,24 @@ private:
 		step_content_done
 	};
 
+	// State of chunked transfer-encoding decoder.
+	enum chunk_state_t {
+		// Waiting for chunk size line, e.g. "1a2b;ext=value".
+		chunk_size = 0,
+
+		// Receiving chunk data.
+		chunk_data,
+
+		// Waiting for CRLF after chunk data.
+		chunk_data_end,
+
+		// Waiting for trailer fields (they are ignored) or the final CRLF.
+		chunk_trailer,
+
+		// The last chunk and trailer were received.
+		chunk_done
+	};
+
 	enum class next_line_t {
 		// A new line was gotten.
 		ok,
@@ -88,7 +115,16 @@ public:
 
 		// HTTP package is not completely received,
 		// need to receive more data.
-		more = 2
+		more = 2,
+
+		// Request line and header were parsed (it's returned once per
+		// request). Caller could call stream_body() before calling
+		// continue_to_parse() again to parse body.
+		header = 3,
+
+		// A body chunk was received in streaming mode (see chunk()),
+		// need to receive more data.
+		chunk = 4
 	};
 
 public:
@@ -125,15 +161,25 @@ public:
 
 	// Get header value.
 	//
+	// Well-known headers (see http_header_t::known_t) are found in O(1),
+	// others are searched in arrival order.
 	// If the specified header does not exist, then NULL will be returned.
 	const fast_str_t* header(const fast_str_t& key) const;
 
+	// Get value of a well-known header (http_header_t::known_???).
+	const fast_str_t* header(http_header_t::known_t key) const {
+		assert(key >= 0 && key < http_header_t::known_count);
+
+		const int index = this->m_known[key];
+		return index < 0 ? 0 : &(this->m_headers[index].value());
+	}
+
 	// Get host name (Similar to request header "Host:???", but does not have port number)
 	const fast_str_t& hostname() const {
 		return this->m_hostname;
 	}
 
-	// Get all headers.
+	// Get all headers (in arrival order).
 	const std::vector<http_header_t>& headers() const {
 		return this->m_headers;
 	}
@@ -144,21 +190,87 @@ public:
 	}
 
 	// Get content size.
+	//
+	// It's value of "Content-Length", or size of decoded body
+	// (when body is completely received) if it's chunked.
 	size_t content_length() const {
 		return this->m_content_length;
 	}
 
+	// Whether body is in chunked transfer-encoding ("Transfer-Encoding: chunked").
+	bool chunked() const {
+		return this->m_chunked;
+	}
+
+	// Whether body is received chunk by chunk.
+	bool stream_body() const {
+		return this->m_stream_body;
+	}
+
+	// Receive body chunk by chunk, rather than as a whole.
+	//
+	// In streaming mode, body is not limited by config_t::max_body_size(),
+	// content() is always NULL, and each body chunk is available by chunk()
+	// after continue_to_parse() returns parse_result_t::chunk
+	// (or parse_result_t::ok for the last one).
+	void stream_body(bool value) {
+		assert(this->m_step == step_header_done);
+		this->m_stream_body = value;
+	}
+
+	// Body chunk just received in streaming mode, it might be empty.
+	//
+	// It points to receive buffer, and is valid until next call to continue_to_parse(),
+	// which removes it from receive buffer. If body is chunked, it's decoded data.
+	// Note that it has nothing to do with chunks of chunked transfer-encoding.
+	const fast_str_t& chunk() const {
+		return this->m_chunk;
+	}
+
+	// Request line and header have been parsed, waiting for content.
+	bool header_done() const {
+		return this->m_step >= step_header_done;
+	}
+
 	// Continue to parse request.
 	//
 	// A http request might be delivered in several TCP packets.
 	// In order to enhance performance, "continue_to_parse" is able to
-	// resume work from where it stopped last time.
-	parse_result_t continue_to_parse(const buf_t* recv_buf, size_t* bytes);
+	// resume work from where it stopped last time, each received byte
+	// of request line and header is scanned only once.
+	//
+	// It fails if request line and header are bigger than cfg.max_header_size().
+	// <BR>
+	//
+	// Chunked body is decoded in place: chunk data is moved to follow
+	// request header and chunk framing is removed from "recv_buf",
+	// so no memory is allocated and content() is contiguous.
+	// <BR>
+	//
+	// "bytes" is set to the size of request package (in "recv_buf")
+	// when parse_result_t::ok is returned.
+	parse_result_t continue_to_parse(const config_t& cfg, buf_t* recv_buf, size_t* bytes);
 
 private:
-	static next_line_t next_line_i(fast_str_t* msg, fast_str_t* line, bool* crlf);
+	// Get next line from "msg". Bytes before "m_scanned_bytes"
+	// are known to have no new-line character, so they are skipped.
+	next_line_t next_line_i(fast_str_t* msg, fast_str_t* line, bool* crlf);
 	static bool split_header_line_i(const fast_str_t& line, fast_str_t* key, fast_str_t* value);
 
+	// Parse a decimal length, e.g. "Content-Length".
+	static bool parse_length_i(const fast_str_t& str, size_t* value);
+
+	// Parse size line of chunked transfer-encoding (hex, extensions are ignored).
+	static bool parse_chunk_size_i(const fast_str_t& line, size_t* value);
+
+	// Decode received body, return false if it's malformed.
+	bool decode_length_i(const config_t& cfg, const buf_t* recv_buf);
+	bool decode_chunked_i(const config_t& cfg, buf_t* recv_buf);
+
+	// Move bytes not decoded yet to follow decoded body, so that
+	// chunk framing (or a body chunk processed by caller) is removed.
+	void compact_i(buf_t* recv_buf);
+
 	// Update fast_str_t's internal pointer.
 	//
 	// If recv_buf was re-allocated, we need to update
@@ -196,13 +308,46 @@ private:
 	// Similar to "Host:???", but does not have port number.
 	fast_str_t m_hostname;
 
-	// An ascending sorted header list (case insensitive).
+	// Headers in arrival order.
 	std::vector<http_header_t> m_headers;
+
+	// Index (of "m_headers") of the first well-known header
+	// of each kind, or -1 if it's not received.
+	int m_known[http_header_t::known_count];
 	const char* m_content;
 	size_t m_content_length;
 
+	// Body decoding.
+	//
+	// Decoded body is located right after request header ("m_processed_bytes"),
+	// which is followed by bytes not decoded yet (starting from "m_raw_bytes").
+	// In streaming mode, decoded body is removed once it's processed by caller.
+	bool m_stream_body;
+	bool m_chunked;
+	chunk_state_t m_chunk_state;
+
+	// Bytes left of current chunk data (chunk_data),
+	// or bytes of trailer received (chunk_trailer).
+	size_t m_chunk_left;
+
+	// Body bytes received (decoded) so far.
+	size_t m_body_bytes;
+
+	// Decoded body bytes in receive buffer.
+	size_t m_decoded_bytes;
+
+	// Offset of the first byte not decoded yet.
+	size_t m_raw_bytes;
+
+	// The last body chunk (streaming mode).
+	fast_str_t m_chunk;
+
 	// Processed bytes of request package.
 	size_t m_processed_bytes;
+
+	// Bytes (from beginning of request package) that have been
+	// scanned for the next new-line character.
+	size_t m_scanned_bytes;
 	step_t m_step;
 
 	// Used as buffer.
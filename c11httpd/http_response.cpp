@@ -56,16 +56,51 @@ http_response_t& http_response_t::operator<<(const http_header_t& header) {
 http_response_t& http_response_t::write(const void* data, size_t size) {
 	assert(data != 0 || size == 0);
 
-	// If first line is not written, then write it.
-	if (this->m_header_pos == 0) {
-		this->write_code_i();
-	}
+	this->begin_content_i();
+	this->m_send_buf->push_back(data, size);
+	return *this;
+}
 
-	if (this->m_content_pos == 0) {
-		this->complete_header_i();
-	}
+http_response_t& http_response_t::write(std::string&& data) {
+	assert(this->m_send_chain != 0);
 
-	this->m_send_buf->push_back(data, size);
+	this->begin_content_i();
+	this->m_chain_size += data.size();
+	this->m_send_chain->append(*this->m_send_buf, std::move(data));
+	return *this;
+}
+
+http_response_t& http_response_t::write(const void* data, size_t size,
+	const std::function<void()>& release) {
+	assert(data != 0 || size == 0);
+	assert(this->m_send_chain != 0);
+
+	this->begin_content_i();
+	this->m_chain_size += size;
+	this->m_send_chain->append(*this->m_send_buf, data, size, release);
+	return *this;
+}
+
+http_response_t& http_response_t::write_file(fd_t fd, int64_t offset, size_t size,
+	const std::function<void()>& release) {
+	assert(fd.is_open());
+	assert(offset >= 0);
+	assert(this->m_send_chain != 0);
+
+	this->begin_content_i();
+	this->m_chain_size += size;
+	this->m_send_chain->append_file(*this->m_send_buf, fd, offset, size, release);
+	return *this;
+}
+
+http_response_t& http_response_t::write(const std::shared_ptr<const void>& ref,
+	const void* data, size_t size) {
+	assert(data != 0 || size == 0);
+	assert(this->m_send_chain != 0);
+
+	this->begin_content_i();
+	this->m_chain_size += size;
+	this->m_send_chain->append(*this->m_send_buf, ref, data, size);
 	return *this;
 }
 
@@ -114,13 +149,24 @@ void http_response_t::write_code_i(int code, const fast_str_t& http_version) {
 	this->m_code = code;
 }
 
+void http_response_t::begin_content_i() {
+	// If first line is not written, then write it.
+	if (this->m_header_pos == 0) {
+		this->write_code_i();
+	}
+
+	if (this->m_content_pos == 0) {
+		this->complete_header_i();
+	}
+}
+
 void http_response_t::complete_header_i() {
 	assert(m_header_pos != 0);
 	assert(m_content_pos == 0);
 
 	// "Connection: keep-alive"
 	if (this->m_config->enabled(config_t::keep_alive)) {
-		const fast_str_t* value = this->m_request->header(http_header_t::Connection);
+		const fast_str_t* value = this->m_request->header(http_header_t::known_connection);
 		if (value != 0) {
 			value->split(" \t,", &this->m_split_items);
 
@@ -153,30 +199,24 @@ void http_response_t::complete_header_i() {
 				<< *m_default_response_content_type << "\r\n";
 	}
 
-	// "Content-Length:       0"
+	// "Content-Length:           0"
 	*m_send_buf << http_header_t::Content_Length << ":";
 	m_content_len_pos = m_send_buf->size();
-	*m_send_buf << "       0\r\n";
+	*m_send_buf << "           0\r\n";
 	*m_send_buf << "\r\n";
 	m_content_pos = m_send_buf->size();
 }
 
 void http_response_t::complete_content_i() {
-	// If first line is not written, then write it.
-	if (this->m_header_pos == 0) {
-		this->write_code_i();
-	}
-
-	if (this->m_content_pos == 0) {
-		this->complete_header_i();
-	}
+	this->begin_content_i();
 
-	const int content_len = int(this->m_send_buf->size() - this->m_content_pos);
+	// Content in the send buffer and in the send chain.
+	const size_t content_len = this->m_send_buf->size() - this->m_content_pos + this->m_chain_size;
 	if (content_len > 0) {
 		char buf[32];
-		const int str_len = std::snprintf(buf, sizeof(buf), "%d", content_len);
-		if (str_len > 0 && str_len <= 8) {
-			char* ptr = this->m_send_buf->front() + this->m_content_len_pos + (8 - str_len);
+		const int str_len = std::snprintf(buf, sizeof(buf), "%zu", content_len);
+		if (str_len > 0 && str_len <= content_len_width) {
+			char* ptr = this->m_send_buf->front() + this->m_content_len_pos + (content_len_width - str_len);
 			for (int i = 0; i < str_len; ++i) {
 				ptr[i] = buf[i];
 			}
@@ -14,6 +14,9 @@
 #include "c11httpd/http_request.h"
 #include "c11httpd/http_status.h"
 #include "c11httpd/rest_result.h"
+#include "c11httpd/send_chain.h"
+#include <functional>
+#include <memory>
 #include <string>
 #include <set>
 #include <vector>
@@ -42,6 +45,8 @@ public:
 		this->m_request = 0;
 		this->m_default_response_content_type = 0;
 		this->m_send_buf = 0;
+		this->m_send_chain = 0;
+		this->m_chain_size = 0;
 		this->m_code = http_status_t::ok;
 		this->m_code_pos = 0;
 		this->m_header_pos = 0;
@@ -54,13 +59,14 @@ public:
 	void attach(const config_t* cfg,
 		const http_request_t* request,
 		const std::string* default_response_content_type,
-		buf_t* send_buf) {
+		buf_t* send_buf, send_chain_t* send_chain) {
 		this->clear();
 
 		this->m_config = cfg;
 		this->m_request = request;
 		this->m_default_response_content_type = default_response_content_type;
 		this->m_send_buf = send_buf;
+		this->m_send_chain = send_chain;
 	}
 
 	void detach(rest_result_t result) {
@@ -99,6 +105,27 @@ public:
 	http_response_t& operator<<(const std::string& str);
 	http_response_t& operator<<(const fast_str_t& str);
 
+	// Write response content without copying it to the send buffer,
+	// it's sent by writev() (see send_chain_t).
+	//
+	// 1) "data" is moved to the response.
+	// 2) "data" is borrowed, "release" (could be empty) is called
+	//    after it has been sent (or the connection is closed).
+	// 3) "ref" keeps "data" alive until it has been sent.
+	http_response_t& write(std::string&& data);
+	http_response_t& write(const void* data, size_t size,
+		const std::function<void()>& release);
+	http_response_t& write(const std::shared_ptr<const void>& ref,
+		const void* data, size_t size);
+
+	// Write "size" bytes of a file from "offset" as response content,
+	// it's sent by sendfile() without being read into memory.
+	//
+	// The file must not be closed until "release" (could be empty) is called,
+	// which happens after it has been sent (or the connection is closed).
+	http_response_t& write_file(fd_t fd, int64_t offset, size_t size,
+		const std::function<void()>& release);
+
 private:
 	http_response_t(const http_response_t&) = delete;
 	http_response_t& operator=(const http_response_t&) = delete;
@@ -106,10 +133,17 @@ private:
 	void write_code_i(int code = http_status_t::ok,
 		const fast_str_t& http_version = http_header_t::HTTP_VERSION_1_1);
 
+	// Write first line and header if they are not written.
+	void begin_content_i();
+
 	void complete_header_i();
 	void complete_content_i();
 
 private:
+	enum {
+		content_len_width = 12
+	};
+
 	// Some headers are protected, not allowed to update by caller.
 	static const std::set<fast_str_t, fast_str_less_nocase_t> st_protected_headers;
 
@@ -118,6 +152,10 @@ private:
 	const http_request_t* m_request;
 	const std::string* m_default_response_content_type;
 	buf_t* m_send_buf;
+	send_chain_t* m_send_chain;
+
+	// Bytes of response content in send chain.
+	size_t m_chain_size;
 
 	// HTTP status code.
 	int m_code;
@@ -128,7 +166,8 @@ private:
 	// Where response header is located.
 	size_t m_header_pos;
 
-	// Where content length is located (totally 8 characters available to write).
+	// Where content length is located (totally "content_len_width"
+	// characters available to write).
 	size_t m_content_len_pos;
 
 	// Where response content is located.
@@ -0,0 +1,269 @@
+/**
+ * HTTP router.
+ *
+ * Copyright (c) 2015 Alex Jin (toalexjin@hotmail.com)
+ */
+
+#include "c11httpd/http_router.h"
+
+
+namespace c11httpd {
+
+
+void http_router_t::clear() {
+	this->m_default.reset();
+	this->m_hosts.clear();
+	this->m_max_placeholders = 0;
+}
+
+void http_router_t::build(const std::vector<rest_ctrl_t*>& controllers) {
+	this->clear();
+	this->m_default.reset(new node_t());
+
+	for (auto controller : controllers) {
+		assert(controller != 0);
+
+		node_t* root;
+
+		if (controller->virtual_host().empty()) {
+			root = this->m_default.get();
+		} else {
+			const auto it = this->m_hosts.find(controller->virtual_host());
+			if (it != this->m_hosts.end()) {
+				root = it->second.get();
+			} else {
+				root = new node_t();
+				root->m_segment = controller->virtual_host();
+				this->m_hosts[fast_str_t(root->m_segment)].reset(root);
+			}
+		}
+
+		for (const auto& api : controller->apis()) {
+			this->add_i(root, controller->uri_root() + std::get<0>(api),
+				std::get<1>(api), &api);
+		}
+	}
+}
+
+void http_router_t::add_i(node_t* root, const std::string& uri,
+	int method, const rest_ctrl_t::api_t* api) {
+	assert(root != 0);
+	assert(api != 0);
+
+	if (method <= http_method_t::unknown || method > http_method_t::head) {
+		assert(false);
+		return;
+	}
+
+	const char* pos = uri.c_str();
+	const char* const end = uri.c_str() + uri.length();
+	node_t* node = root;
+	size_t placeholders = 0;
+	fast_str_t segment;
+
+	while (next_segment_i(&pos, end, &segment)) {
+		if (segment == "*") {
+			if (!node->m_rest) {
+				node->m_rest.reset(new node_t());
+				node->m_rest->m_segment = segment.to_str();
+			}
+
+			// "*" is always the last segment.
+			node = node->m_rest.get();
+			++ placeholders;
+			break;
+		} else if (segment == "?") {
+			if (!node->m_one) {
+				node->m_one.reset(new node_t());
+				node->m_one->m_segment = segment.to_str();
+			}
+
+			node = node->m_one.get();
+			++ placeholders;
+		} else {
+			const auto it = node->m_children.find(segment);
+			if (it != node->m_children.end()) {
+				node = it->second.get();
+			} else {
+				auto child = new node_t();
+				child->m_segment = segment.to_str();
+				node->m_children[fast_str_t(child->m_segment)].reset(child);
+				node = child;
+			}
+		}
+	}
+
+	// If several APIs have the same URI & method, the first one wins.
+	if (node->m_apis[method] == 0) {
+		node->m_apis[method] = api;
+		node->m_has_api = true;
+	}
+
+	if (placeholders > this->m_max_placeholders) {
+		this->m_max_placeholders = placeholders;
+	}
+}
+
+http_router_t::find_result_t http_router_t::find(const fast_str_t& hostname,
+	int method, const fast_str_t& uri, std::vector<fast_str_t>* placeholders,
+	const rest_ctrl_t::api_t** api) const {
+	assert(placeholders != 0 && placeholders->empty());
+	assert(api != 0);
+
+	*api = 0;
+
+	if (method <= http_method_t::unknown || method > http_method_t::head) {
+		return find_result_t::not_found;
+	}
+
+	const char* const pos = uri.c_str();
+	const char* const end = uri.c_str() + uri.length();
+	find_result_t result = find_result_t::not_found;
+
+	// Virtual host first.
+	if (!hostname.empty() && !this->m_hosts.empty()) {
+		const auto it = this->m_hosts.find(hostname);
+		if (it != this->m_hosts.end()) {
+			result = find_i(it->second.get(), pos, end, method, placeholders, api);
+			if (result == find_result_t::ok) {
+				return result;
+			}
+		}
+	}
+
+	if (this->m_default) {
+		const auto tmp = find_i(this->m_default.get(), pos, end, method, placeholders, api);
+		if (tmp != find_result_t::not_found) {
+			result = tmp;
+		}
+	}
+
+	return result;
+}
+
+bool http_router_t::next_segment_i(const char** pos, const char* end, fast_str_t* segment) {
+	assert(pos != 0 && *pos != 0);
+	assert(segment != 0);
+
+	const char* first = *pos;
+
+	// Skip "/", empty segments are ignored.
+	while (first != end && *first == '/') {
+		++first;
+	}
+
+	if (first == end) {
+		*pos = end;
+		segment->clear();
+		return false;
+	}
+
+	const char* last = first + 1;
+	while (last != end && *last != '/') {
+		++last;
+	}
+
+	segment->set(first, last - first);
+	*pos = last;
+	return true;
+}
+
+http_router_t::find_result_t http_router_t::match_api_i(const node_t* node,
+	int method, const rest_ctrl_t::api_t** api) {
+	assert(node != 0);
+
+	if (node->m_apis[method] != 0) {
+		*api = node->m_apis[method];
+	} else if (node->m_apis[http_method_t::any] != 0) {
+		*api = node->m_apis[http_method_t::any];
+	} else if (node->m_has_api) {
+		return find_result_t::method_not_allowed;
+	} else {
+		return find_result_t::not_found;
+	}
+
+	return find_result_t::ok;
+}
+
+http_router_t::find_result_t http_router_t::find_i(const node_t* node,
+	const char* pos, const char* end, int method,
+	std::vector<fast_str_t>* placeholders, const rest_ctrl_t::api_t** api) {
+	find_result_t result = find_result_t::not_found;
+	find_result_t tmp;
+	fast_str_t segment;
+	const char* next = pos;
+
+	if (!next_segment_i(&next, end, &segment)) {
+		// All segments are matched.
+		result = match_api_i(node, method, api);
+		if (result == find_result_t::ok) {
+			return result;
+		}
+
+		// "*" matches empty value.
+		if (node->m_rest) {
+			placeholders->push_back(fast_str_t(end, 0));
+
+			tmp = match_api_i(node->m_rest.get(), method, api);
+			if (tmp == find_result_t::ok) {
+				return tmp;
+			}
+
+			placeholders->pop_back();
+			if (tmp == find_result_t::method_not_allowed) {
+				result = tmp;
+			}
+		}
+
+		return result;
+	}
+
+	// Constant string.
+	const auto it = node->m_children.find(segment);
+	if (it != node->m_children.end()) {
+		tmp = find_i(it->second.get(), next, end, method, placeholders, api);
+		if (tmp == find_result_t::ok) {
+			return tmp;
+		}
+
+		if (tmp == find_result_t::method_not_allowed) {
+			result = tmp;
+		}
+	}
+
+	// "?"
+	if (node->m_one) {
+		placeholders->push_back(segment);
+
+		tmp = find_i(node->m_one.get(), next, end, method, placeholders, api);
+		if (tmp == find_result_t::ok) {
+			return tmp;
+		}
+
+		placeholders->pop_back();
+		if (tmp == find_result_t::method_not_allowed) {
+			result = tmp;
+		}
+	}
+
+	// "*"
+	if (node->m_rest) {
+		placeholders->push_back(fast_str_t(segment.c_str(), end - segment.c_str()));
+
+		tmp = match_api_i(node->m_rest.get(), method, api);
+		if (tmp == find_result_t::ok) {
+			return tmp;
+		}
+
+		placeholders->pop_back();
+		if (tmp == find_result_t::method_not_allowed) {
+			result = tmp;
+		}
+	}
+
+	return result;
+}
+
+
+} // namespace c11httpd.
+
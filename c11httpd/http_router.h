@@ -0,0 +1,140 @@
+/**
+ * HTTP router.
+ *
+ * Copyright (c) 2015 Alex Jin (toalexjin@hotmail.com)
+ */
+
+#pragma once
+
+#include "c11httpd/pre__.h"
+#include "c11httpd/fast_str.h"
+#include "c11httpd/http_method.h"
+#include "c11httpd/rest_ctrl.h"
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+namespace c11httpd {
+
+
+// HTTP router.
+//
+// http_router_t compiles APIs of all controllers into a tree of
+// URI segments (one tree per virtual host), so that dispatching
+// a request costs O(URI length) no matter how many APIs are registered.
+// <BR>
+//
+// A segment of API URI could be:
+// -# A constant string, e.g. "employee" in "/company/employee".
+// -# "?", matches exactly one segment, e.g. "/company/employee/?".
+// -# "*", matches all the rest segments (might be empty),
+//    must be the last segment, e.g. "/static/*".
+//
+// When several APIs match the same URI, constant string wins over "?",
+// and "?" wins over "*". For each matched "?" or "*", a placeholder value
+// (pointing to the request URI) is appended to "placeholders".
+class http_router_t {
+public:
+	enum class find_result_t {
+		// An API was found.
+		ok = 0,
+
+		// URI was not found.
+		not_found = 1,
+
+		// URI was found, but the method is not supported.
+		method_not_allowed = 2
+	};
+
+public:
+	http_router_t() = default;
+	~http_router_t() = default;
+
+	// Remove all routes.
+	void clear();
+
+	// Build route tree.
+	//
+	// Note that API objects are referenced by the route tree,
+	// so controllers must NOT be updated after calling this function.
+	void build(const std::vector<rest_ctrl_t*>& controllers);
+
+	// Find the API of a request.
+	//
+	// "placeholders" must be empty when calling this function. If it has
+	// enough capacity (see max_placeholders()), no memory would be allocated.
+	find_result_t find(const fast_str_t& hostname, int method,
+		const fast_str_t& uri, std::vector<fast_str_t>* placeholders,
+		const rest_ctrl_t::api_t** api) const;
+
+	// Max number of placeholders of all APIs.
+	size_t max_placeholders() const {
+		return this->m_max_placeholders;
+	}
+
+private:
+	class node_t {
+	public:
+		node_t() {
+			for (auto& item : this->m_apis) {
+				item = 0;
+			}
+
+			this->m_has_api = false;
+		}
+
+		// Segment value, also used as key of parent's "m_children".
+		std::string m_segment;
+
+		// Constant string segments.
+		std::map<fast_str_t, std::unique_ptr<node_t>, fast_str_less_t> m_children;
+
+		// "?" segment.
+		std::unique_ptr<node_t> m_one;
+
+		// "*" segment.
+		std::unique_ptr<node_t> m_rest;
+
+		// APIs indexed by method.
+		const rest_ctrl_t::api_t* m_apis[http_method_t::head + 1];
+		bool m_has_api;
+
+	private:
+		node_t(const node_t&) = delete;
+		node_t& operator=(const node_t&) = delete;
+	};
+
+private:
+	http_router_t(const http_router_t&) = delete;
+	http_router_t& operator=(const http_router_t&) = delete;
+
+	// Add an API to a route tree.
+	void add_i(node_t* root, const std::string& uri,
+		int method, const rest_ctrl_t::api_t* api);
+
+	// Get next segment, return false if there is no more segment.
+	static bool next_segment_i(const char** pos, const char* end, fast_str_t* segment);
+
+	// Set API result of a matched node.
+	static find_result_t match_api_i(const node_t* node,
+		int method, const rest_ctrl_t::api_t** api);
+
+	static find_result_t find_i(const node_t* node,
+		const char* pos, const char* end, int method,
+		std::vector<fast_str_t>* placeholders, const rest_ctrl_t::api_t** api);
+
+private:
+	// Route tree for requests matching no virtual host.
+	std::unique_ptr<node_t> m_default;
+
+	// Route trees of virtual hosts (case insensitive).
+	std::map<fast_str_t, std::unique_ptr<node_t>, fast_str_less_nocase_t> m_hosts;
+
+	size_t m_max_placeholders = 0;
+};
+
+
+} // namespace c11httpd.
+
@@ -18,7 +18,10 @@ public:
 	enum {
 		ok = 200,
 		parial_content = 206,
-		not_found = 404
+		not_modified = 304,
+		forbidden = 403,
+		not_found = 404,
+		method_not_allowed = 405
 	};
 };
 
@@ -112,12 +112,33 @@ public:
 		http_response_t& // Output response.
 	> routine_callable_t;
 
+	// Body routine prototype (see add_stream()).
+	typedef std::function<
+		rest_result_t(
+			ctx_setter_t&, // Context getter/setter.
+			conn_session_t&, // Connection session.
+			const http_request_t&, // Input request.
+			const std::vector<fast_str_t>&, // URI placeholder values.
+			const fast_str_t& // Body chunk.
+		)
+	> body_routine_t;
+
+	typedef details::callable_t<
+		rest_result_t,
+		ctx_setter_t&, // Context getter/setter.
+		conn_session_t&, // Connection session.
+		const http_request_t&, // Input request.
+		const std::vector<fast_str_t>&, // URI placeholder values.
+		const fast_str_t& // Body chunk.
+	> body_callable_t;
+
 	typedef std::tuple<
 		std::string, // URI. e.g. "/company/employee/?".
 		int, // Method, e.g.GET/PUT/POST/DELETE.
 		std::unique_ptr<routine_callable_t>, // Routine.
 		std::string, // (Optional) Request "Content-Type"
-		std::string // (Optional) Response "Content-Type"
+		std::string, // (Optional) Response "Content-Type"
+		std::unique_ptr<body_callable_t> // (Optional) Body routine.
 	> api_t;
 
 public:
@@ -170,7 +191,8 @@ public:
 						>(routine)
 				),
 				request_content_type,
-				response_content_type
+				response_content_type,
+				std::unique_ptr<body_callable_t>()
 			)
 		);
 	}
@@ -193,7 +215,8 @@ public:
 						>(routine)
 				),
 				request_content_type,
-				response_content_type
+				response_content_type,
+				std::unique_ptr<body_callable_t>()
 			)
 		);
 	}
@@ -220,11 +243,66 @@ public:
 					>(self, routine)
 				),
 				request_content_type,
-				response_content_type
+				response_content_type,
+				std::unique_ptr<body_callable_t>()
 			)
 		);
 	}
 
+	// Add an API that receives request body chunk by chunk.
+	//
+	// "body_routine" is invoked for each (non-empty) body chunk as soon
+	// as it's received, then "routine" is invoked to make the response
+	// (http_request_t::content() is NULL). Body is not limited by
+	// config_t::max_body_size(), and only one chunk is kept in memory.
+	// <BR>
+	//
+	// Chunks are delivered in event loop, no more data of this connection
+	// is received until "body_routine" returns, so a slow consumer slows
+	// down the client by TCP flow control. Return rest_result_t::abandon
+	// to reject the request and close the connection.
+	void add_stream(const std::string& uri,
+		int method,
+		const body_routine_t& body_routine,
+		const routine_cpp_t& routine,
+		const std::string& request_content_type = std::string(),
+		const std::string& response_content_type = std::string()
+		) {
+		this->add(uri, method, routine, request_content_type, response_content_type);
+
+		std::get<5>(this->m_apis.back()).reset(
+			new details::callable_c_t<
+				body_routine_t, rest_result_t, ctx_setter_t&,
+				conn_session_t&, const http_request_t&,
+				const std::vector<fast_str_t>&, const fast_str_t&
+			>(body_routine)
+		);
+	}
+
+	template <typename T>
+	void add_stream(const std::string& uri,
+		int method,
+		T* self,
+		rest_result_t (T::*body_routine)(ctx_setter_t&,
+				conn_session_t&, const http_request_t&,
+				const std::vector<fast_str_t>&, const fast_str_t&),
+		rest_result_t (T::*routine)(ctx_setter_t&,
+				conn_session_t&, const http_request_t&,
+				const std::vector<fast_str_t>&, http_response_t&),
+		const std::string& request_content_type = std::string(),
+		const std::string& response_content_type = std::string()
+		) {
+		this->add(uri, method, self, routine, request_content_type, response_content_type);
+
+		std::get<5>(this->m_apis.back()).reset(
+			new details::callable_cpp_t<
+				T, rest_result_t, ctx_setter_t&,
+				conn_session_t&, const http_request_t&,
+				const std::vector<fast_str_t>&, const fast_str_t&
+			>(self, body_routine)
+		);
+	}
+
 private:
 	std::string m_uri_root;
 	std::string m_virtual_host;
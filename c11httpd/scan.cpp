@@ -0,0 +1,110 @@
+/**
+ * Character scanning.
+ *
+ * Copyright (c) 2015 Alex Jin (toalexjin@hotmail.com)
+ */
+
+#include "c11httpd/scan.h"
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+
+namespace c11httpd {
+
+
+namespace {
+
+const char* find_scalar(const char* begin, const char* end, char ch1, char ch2) {
+	for (const char* pos = begin; pos != end; ++pos) {
+		if (*pos == ch1 || *pos == ch2) {
+			return pos;
+		}
+	}
+
+	return end;
+}
+
+#if defined(__SSE2__)
+
+const char* find_sse2(const char* begin, const char* end, char ch1, char ch2) {
+	const __m128i v1 = _mm_set1_epi8(ch1);
+	const __m128i v2 = _mm_set1_epi8(ch2);
+	const char* pos = begin;
+
+	while (end - pos >= 16) {
+		const __m128i data = _mm_loadu_si128((const __m128i*) pos);
+		const int mask = _mm_movemask_epi8(_mm_or_si128(
+			_mm_cmpeq_epi8(data, v1), _mm_cmpeq_epi8(data, v2)));
+
+		if (mask != 0) {
+			return pos + __builtin_ctz(mask);
+		}
+
+		pos += 16;
+	}
+
+	return find_scalar(pos, end, ch1, ch2);
+}
+
+__attribute__((target("avx2")))
+const char* find_avx2(const char* begin, const char* end, char ch1, char ch2) {
+	const __m256i v1 = _mm256_set1_epi8(ch1);
+	const __m256i v2 = _mm256_set1_epi8(ch2);
+	const char* pos = begin;
+
+	while (end - pos >= 32) {
+		const __m256i data = _mm256_loadu_si256((const __m256i*) pos);
+		const int mask = _mm256_movemask_epi8(_mm256_or_si256(
+			_mm256_cmpeq_epi8(data, v1), _mm256_cmpeq_epi8(data, v2)));
+
+		if (mask != 0) {
+			return pos + __builtin_ctz(mask);
+		}
+
+		pos += 32;
+	}
+
+	// The rest (less than 32 bytes).
+	return find_sse2(pos, end, ch1, ch2);
+}
+
+#endif
+
+} // namespace.
+
+
+const scan_t::find_t scan_t::st_find = scan_t::select_i();
+
+
+const char* scan_t::impl() {
+#if defined(__SSE2__)
+	if (st_find == find_avx2) {
+		return "avx2";
+	} else if (st_find == find_sse2) {
+		return "sse2";
+	}
+#endif
+
+	return "scalar";
+}
+
+scan_t::find_t scan_t::select_i() {
+#if defined(__SSE2__)
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx2")) {
+		return find_avx2;
+	}
+
+	return find_sse2;
+#else
+	return find_scalar;
+#endif
+}
+
+
+} // namespace c11httpd.
+
+
@@ -0,0 +1,50 @@
+/**
+ * Character scanning.
+ *
+ * Copyright (c) 2015 Alex Jin (toalexjin@hotmail.com)
+ */
+
+#pragma once
+
+#include "c11httpd/pre__.h"
+
+
+namespace c11httpd {
+
+
+// Character scanning.
+//
+// Used by HTTP parser to find line breaks and delimiters. Depending on CPU
+// (detected at runtime), 32 bytes (AVX2) or 16 bytes (SSE2) are compared
+// at a time, otherwise one byte at a time.
+class scan_t {
+public:
+	typedef const char* (*find_t)(const char* begin, const char* end, char ch1, char ch2);
+
+public:
+	// Find the first character which is "ch1" or "ch2" in range [begin, end).
+	//
+	// Return "end" if it's not found.
+	static const char* find(const char* begin, const char* end, char ch1, char ch2) {
+		assert(begin <= end);
+
+		return st_find(begin, end, ch1, ch2);
+	}
+
+	// Name of the implementation in use, e.g. "avx2".
+	static const char* impl();
+
+private:
+	scan_t() = delete;
+
+	// Select the fastest implementation supported by CPU.
+	static find_t select_i();
+
+private:
+	static const find_t st_find;
+};
+
+
+} // namespace c11httpd.
+
+
@@ -0,0 +1,237 @@
+/**
+ * Chain of data to send.
+ *
+ * Copyright (c) 2015 Alex Jin (toalexjin@hotmail.com)
+ */
+
+#include "c11httpd/send_chain.h"
+#include <algorithm>
+
+
+namespace c11httpd {
+
+
+void send_chain_t::clear() {
+	while (!this->m_segs.empty()) {
+		this->pop_front_i();
+	}
+
+	this->m_buf_size = 0;
+	this->m_size = 0;
+}
+
+void send_chain_t::append(const buf_t& buf, std::string&& data) {
+	if (data.empty()) {
+		return;
+	}
+
+	this->seal_i(buf);
+	this->m_segs.emplace_back();
+
+	seg_t& seg = this->m_segs.back();
+	seg.m_type = seg_owned;
+	seg.m_owned.swap(data);
+	seg.m_data = seg.m_owned.data();
+	seg.m_size = seg.m_owned.size();
+	this->m_size += seg.m_size;
+}
+
+void send_chain_t::append(const buf_t& buf, const void* data, size_t size,
+	const std::function<void()>& release) {
+	assert(data != 0 || size == 0);
+
+	if (size == 0) {
+		if (release) {
+			release();
+		}
+
+		return;
+	}
+
+	this->seal_i(buf);
+	this->m_segs.emplace_back();
+
+	seg_t& seg = this->m_segs.back();
+	seg.m_type = seg_borrowed;
+	seg.m_data = (const char*) data;
+	seg.m_size = size;
+	seg.m_release = release;
+	this->m_size += size;
+}
+
+void send_chain_t::append(const buf_t& buf, const std::shared_ptr<const void>& ref,
+	const void* data, size_t size) {
+	assert(data != 0 || size == 0);
+
+	if (size == 0) {
+		return;
+	}
+
+	this->seal_i(buf);
+	this->m_segs.emplace_back();
+
+	seg_t& seg = this->m_segs.back();
+	seg.m_type = seg_shared;
+	seg.m_data = (const char*) data;
+	seg.m_size = size;
+	seg.m_ref = ref;
+	this->m_size += size;
+}
+
+void send_chain_t::append_file(const buf_t& buf, fd_t fd, int64_t offset, size_t size,
+	const std::function<void()>& release) {
+	assert(fd.is_open());
+	assert(offset >= 0);
+
+	if (size == 0) {
+		if (release) {
+			release();
+		}
+
+		return;
+	}
+
+	this->seal_i(buf);
+	this->m_segs.emplace_back();
+
+	seg_t& seg = this->m_segs.back();
+	seg.m_type = seg_file;
+	seg.m_data = 0;
+	seg.m_size = size;
+	seg.m_fd = fd;
+	seg.m_offset = offset;
+	seg.m_release = release;
+	this->m_size += size;
+}
+
+void send_chain_t::rollback(size_t count) {
+	while (this->m_segs.size() > count) {
+		seg_t& seg = this->m_segs.back();
+
+		if (seg.m_type == seg_buf) {
+			this->m_buf_size -= seg.m_size;
+		} else {
+			this->m_size -= seg.m_size;
+		}
+
+		if (seg.m_release) {
+			seg.m_release();
+		}
+
+		this->m_segs.pop_back();
+	}
+}
+
+int send_chain_t::fill(const buf_t& buf, struct iovec* iov, int max) const {
+	const char* buf_data = buf.front();
+	int count = 0;
+
+	assert(iov != 0 && max > 0);
+	assert(this->m_buf_size <= buf.size());
+
+	auto it = this->m_segs.begin();
+
+	for (; it != this->m_segs.end() && count < max; ++it) {
+		// File segments are sent by sendfile().
+		if ((*it).m_type == seg_file) {
+			return count;
+		}
+
+		if ((*it).m_type == seg_buf) {
+			iov[count].iov_base = (void*) buf_data;
+			buf_data += (*it).m_size;
+		} else {
+			iov[count].iov_base = (void*) (*it).m_data;
+		}
+
+		iov[count].iov_len = (*it).m_size;
+		++ count;
+	}
+
+	// Content of the send buffer after the last segment.
+	if (it == this->m_segs.end() && count < max && buf.size() > this->m_buf_size) {
+		iov[count].iov_base = (void*) (buf.front() + this->m_buf_size);
+		iov[count].iov_len = buf.size() - this->m_buf_size;
+		++ count;
+	}
+
+	return count;
+}
+
+bool send_chain_t::front_file(fd_t* fd, int64_t* offset, size_t* size) const {
+	assert(fd != 0);
+	assert(offset != 0);
+	assert(size != 0);
+
+	if (this->m_segs.empty() || this->m_segs.front().m_type != seg_file) {
+		return false;
+	}
+
+	const seg_t& seg = this->m_segs.front();
+	*fd = seg.m_fd;
+	*offset = seg.m_offset;
+	*size = seg.m_size;
+
+	return true;
+}
+
+void send_chain_t::consume(buf_t* buf, size_t bytes) {
+	assert(buf != 0);
+
+	while (bytes > 0) {
+		if (this->m_segs.empty()) {
+			buf->erase_front(bytes);
+			break;
+		}
+
+		seg_t& seg = this->m_segs.front();
+		const size_t n = std::min(bytes, seg.m_size);
+
+		if (seg.m_type == seg_buf) {
+			buf->erase_front(n);
+			this->m_buf_size -= n;
+		} else if (seg.m_type == seg_file) {
+			seg.m_offset += n;
+			this->m_size -= n;
+		} else {
+			seg.m_data += n;
+			this->m_size -= n;
+		}
+
+		seg.m_size -= n;
+		bytes -= n;
+
+		if (seg.m_size == 0) {
+			this->pop_front_i();
+		}
+	}
+}
+
+void send_chain_t::seal_i(const buf_t& buf) {
+	assert(this->m_buf_size <= buf.size());
+
+	if (buf.size() > this->m_buf_size) {
+		this->m_segs.emplace_back();
+
+		seg_t& seg = this->m_segs.back();
+		seg.m_type = seg_buf;
+		seg.m_data = 0;
+		seg.m_size = buf.size() - this->m_buf_size;
+		this->m_buf_size = buf.size();
+	}
+}
+
+void send_chain_t::pop_front_i() {
+	seg_t& seg = this->m_segs.front();
+
+	if (seg.m_release) {
+		seg.m_release();
+	}
+
+	this->m_segs.pop_front();
+}
+
+
+} // namespace c11httpd.
+
+
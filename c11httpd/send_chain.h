@@ -0,0 +1,164 @@
+/**
+ * Chain of data to send.
+ *
+ * Copyright (c) 2015 Alex Jin (toalexjin@hotmail.com)
+ */
+
+#pragma once
+
+#include "c11httpd/pre__.h"
+#include "c11httpd/buf.h"
+#include "c11httpd/fd.h"
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <sys/uio.h>
+
+
+namespace c11httpd {
+
+
+// Chain of data to send.
+//
+// Large payloads (e.g. a blob owned by the handler) are appended to the chain
+// as segments without being copied to the send buffer, and the whole
+// chain is sent by writev().
+// <BR>
+//
+// Data of the send buffer (buf_t) is interleaved with segments: when a segment
+// is appended, content of the send buffer that is not in the chain yet
+// becomes a "buffer" segment, which just records its length. Content after
+// the last segment is sent after all segments. So the order of data is kept,
+// and if no segment is appended, only the send buffer is sent (as before).
+// <BR>
+//
+// A segment could be:
+// 1) Owned: a std::string moved to the chain.
+// 2) Borrowed: memory of caller, "release" is called after it's sent
+//    (or the connection is closed).
+// 3) Refcounted: a std::shared_ptr keeps memory alive until it's sent.
+// 4) File: a range of a file, which is sent by sendfile() without being
+//    read into memory. "release" is called after it's sent.
+class send_chain_t {
+public:
+	// Max number of iovec entries of one writev() call.
+	enum {
+		max_iov = 16
+	};
+
+	send_chain_t() {
+		this->m_buf_size = 0;
+		this->m_size = 0;
+	}
+
+	~send_chain_t() {
+		this->clear();
+	}
+
+	// No segment.
+	bool empty() const {
+		return this->m_segs.empty();
+	}
+
+	// Bytes of memory & file segments (content of the send buffer is not included).
+	size_t size() const {
+		return this->m_size;
+	}
+
+	// Number of segments, used by rollback().
+	size_t count() const {
+		return this->m_segs.size();
+	}
+
+	// Remove all segments, borrowed memory is released.
+	void clear();
+
+	// Exchange segments with another chain.
+	void swap(send_chain_t& another) {
+		this->m_segs.swap(another.m_segs);
+		std::swap(this->m_buf_size, another.m_buf_size);
+		std::swap(this->m_size, another.m_size);
+	}
+
+	// Append an owned segment.
+	void append(const buf_t& buf, std::string&& data);
+
+	// Append a borrowed segment, "release" (could be empty) is called
+	// when the memory is not used any more.
+	void append(const buf_t& buf, const void* data, size_t size,
+		const std::function<void()>& release);
+
+	// Append a refcounted segment, "ref" keeps "data" alive.
+	void append(const buf_t& buf, const std::shared_ptr<const void>& ref,
+		const void* data, size_t size);
+
+	// Append a file segment, "release" (could be empty) is called
+	// when the file is not used any more.
+	void append_file(const buf_t& buf, fd_t fd, int64_t offset, size_t size,
+		const std::function<void()>& release);
+
+	// Remove segments appended after count() returned "count".
+	//
+	// It must be called before the send buffer is restored to its size
+	// of that time.
+	void rollback(size_t count);
+
+	// Fill iovec entries from the beginning of the chain,
+	// until a file segment.
+	//
+	// Return number of entries.
+	int fill(const buf_t& buf, struct iovec* iov, int max) const;
+
+	// If the first segment is a file segment, get its range.
+	bool front_file(fd_t* fd, int64_t* offset, size_t* size) const;
+
+	// Remove "bytes" sent bytes from the beginning of the chain
+	// (and the send buffer).
+	void consume(buf_t* buf, size_t bytes);
+
+private:
+	send_chain_t(const send_chain_t&) = delete;
+	send_chain_t& operator=(const send_chain_t&) = delete;
+
+	enum {
+		seg_buf = 0,
+		seg_owned,
+		seg_borrowed,
+		seg_shared,
+		seg_file
+	};
+
+	struct seg_t {
+		int m_type;
+		const char* m_data;
+		size_t m_size;
+		fd_t m_fd;
+		int64_t m_offset;
+		std::string m_owned;
+		std::function<void()> m_release;
+		std::shared_ptr<const void> m_ref;
+	};
+
+	// Make content of the send buffer which is not in the chain a segment.
+	void seal_i(const buf_t& buf);
+
+	// Remove the first segment.
+	void pop_front_i();
+
+private:
+	// A deque never moves its elements when adding (or removing)
+	// at both ends, so owned data does not move.
+	std::deque<seg_t> m_segs;
+
+	// Bytes of the send buffer in "buffer" segments.
+	size_t m_buf_size;
+
+	// Bytes of memory & file segments.
+	size_t m_size;
+};
+
+
+} // namespace c11httpd.
+
+
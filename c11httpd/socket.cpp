@@ -9,6 +9,7 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/sendfile.h>
 #include <arpa/inet.h>
 
 
@@ -106,41 +107,90 @@ err_t socket_t::bind_ipv6(const std::string& ip, uint16_t port) {
 
 err_t socket_t::accept(socket_t* sd, std::string* ip, uint16_t* port, bool* ipv6) {
 	struct sockaddr_storage addr;
-	socklen_t len = sizeof(addr);
-	char buf[INET6_ADDRSTRLEN + 1];
+
+	assert(ip != 0);
+	assert(port != 0);
+	assert(ipv6 != 0);
+
+	auto ret = this->accept(sd, &addr);
+	if (!ret) {
+		return ret;
+	}
+
+	// Set return values.
+	ret = parse_addr(&addr, ip, port, ipv6);
+	if (!ret) {
+		sd->close();
+		return ret;
+	}
+
+	return err_t();
+}
+
+err_t socket_t::accept(socket_t* sd, struct sockaddr_storage* addr, int flags) {
+	socklen_t len = sizeof(*addr);
 
 	assert(this->is_open());
 	assert(sd != 0);
+	assert(addr != 0);
+
+	const auto result = ::accept4(this->get(), (struct sockaddr*) addr, &len, flags);
+	if (result < 0) {
+		return err_t::current();
+	}
+
+	*sd = result;
+	return err_t();
+}
+
+err_t socket_t::peer(std::string* ip, uint16_t* port, bool* ipv6) const {
+	struct sockaddr_storage addr;
+
 	assert(ip != 0);
 	assert(port != 0);
 	assert(ipv6 != 0);
 
-	const auto result = ::accept(this->get(), (struct sockaddr*) &addr, &len);
-	if (result < 0) {
+	const auto ret = this->peer(&addr);
+	if (!ret) {
+		return ret;
+	}
+
+	return parse_addr(&addr, ip, port, ipv6);
+}
+
+err_t socket_t::peer(struct sockaddr_storage* addr) const {
+	socklen_t len = sizeof(*addr);
+
+	assert(this->is_open());
+	assert(addr != 0);
+
+	if (getpeername(this->get(), (struct sockaddr*) addr, &len) != 0) {
 		return err_t::current();
 	}
 
-	// Set return values.
-	if (addr.ss_family == AF_INET) {
-		const auto addr_v4 = (struct sockaddr_in*) &addr;
+	return err_t();
+}
+
+err_t socket_t::parse_addr(const struct sockaddr_storage* storage,
+	std::string* ip, uint16_t* port, bool* ipv6) {
+	char buf[INET6_ADDRSTRLEN + 1];
+
+	if (storage->ss_family == AF_INET) {
+		const auto addr_v4 = (const struct sockaddr_in*) storage;
 
 		if (inet_ntop(AF_INET, &addr_v4->sin_addr, buf, sizeof(buf)) == 0) {
-			const auto e = err_t::current();
-			::close(result);
-			return e;
+			return err_t::current();
 		}
 
 		*ip = buf;
 		*port = ntohs(addr_v4->sin_port);
 		*ipv6 = false;
 
-	} else if (addr.ss_family == AF_INET6) {
-		const auto addr_v6 = (struct sockaddr_in6*) &addr;
+	} else if (storage->ss_family == AF_INET6) {
+		const auto addr_v6 = (const struct sockaddr_in6*) storage;
 
 		if (inet_ntop(AF_INET6, &addr_v6->sin6_addr, buf, sizeof(buf)) == 0) {
-			const auto e = err_t::current();
-			::close(result);
-			return e;
+			return err_t::current();
 		}
 
 		*ip = buf;
@@ -148,11 +198,9 @@ err_t socket_t::accept(socket_t* sd, std::string* ip, uint16_t* port, bool* ipv6
 		*ipv6 = true;
 
 	} else {
-		::close(result);
 		return EINVAL;
 	}
 
-	*sd = result;
 	return err_t();
 }
 
@@ -196,6 +244,59 @@ err_t socket_t::recv(void* buf, size_t size, size_t* ok_bytes) {
 	}
 }
 
+err_t socket_t::readv(const struct iovec* iov, int count, size_t* ok_bytes) {
+	assert(this->is_open());
+	assert(iov != 0 && count > 0);
+	assert(ok_bytes != 0);
+
+	const auto result = ::readv(this->get(), iov, count);
+	if (result == -1) {
+		*ok_bytes = 0;
+		return err_t::current();
+	} else {
+		*ok_bytes = result;
+		return err_t();
+	}
+}
+
+err_t socket_t::sendfile(fd_t file, int64_t offset, size_t size, size_t* ok_bytes) {
+	assert(this->is_open());
+	assert(file.is_open());
+	assert(offset >= 0);
+	assert(ok_bytes != 0);
+
+	off_t off = off_t(offset);
+
+	const auto result = ::sendfile(this->get(), file.get(), &off, size);
+	if (result == -1) {
+		*ok_bytes = 0;
+		return err_t::current();
+	} else if (result == 0 && size > 0) {
+		// File ends before the expected size (e.g. truncated),
+		// the rest would never be sent.
+		*ok_bytes = 0;
+		return EIO;
+	} else {
+		*ok_bytes = result;
+		return err_t();
+	}
+}
+
+err_t socket_t::writev(const struct iovec* iov, int count, size_t* ok_bytes) {
+	assert(this->is_open());
+	assert(iov != 0 && count > 0);
+	assert(ok_bytes != 0);
+
+	const auto result = ::writev(this->get(), iov, count);
+	if (result == -1) {
+		*ok_bytes = 0;
+		return err_t::current();
+	} else {
+		*ok_bytes = result;
+		return err_t();
+	}
+}
+
 bool socket_t::reuseaddr() const {
 	assert(this->is_open());
 
@@ -221,6 +322,31 @@ err_t socket_t::reuseaddr(bool flag) {
 	return err_t();
 }
 
+bool socket_t::reuseport() const {
+	assert(this->is_open());
+
+	int state = 0;
+	socklen_t size = sizeof(state);
+
+	if (getsockopt(this->get(), SOL_SOCKET, SO_REUSEPORT, &state, &size) == -1) {
+		return false;
+	}
+
+	return state == 0 ? false : true;
+}
+
+err_t socket_t::reuseport(bool flag) {
+	assert(this->is_open());
+
+	const int state = flag ? 1 : 0;
+	if (setsockopt(this->get(), SOL_SOCKET, SO_REUSEPORT,
+			&state, (socklen_t) sizeof(state)) == -1) {
+		return err_t::current();
+	}
+
+	return err_t();
+}
+
 
 } // namespace c11httpd.
 
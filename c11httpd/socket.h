@@ -9,6 +9,9 @@
 #include "c11httpd/pre__.h"
 #include "c11httpd/err.h"
 #include "c11httpd/fd.h"
+#include <string>
+#include <sys/socket.h>
+#include <sys/uio.h>
 
 
 namespace c11httpd {
@@ -57,13 +60,42 @@ public:
 	err_t bind_ipv6(const std::string& ip, uint16_t port);
 
 	err_t accept(socket_t* sd, std::string* ip, uint16_t* port, bool* ipv6);
+
+	// Accept a connection, and save the raw address of peer side
+	// (without formatting it).
+	//
+	// "flags" (e.g. SOCK_NONBLOCK, SOCK_CLOEXEC) are passed to accept4(),
+	// so that no extra fcntl() call is needed.
+	err_t accept(socket_t* sd, struct sockaddr_storage* addr, int flags = 0);
+
 	err_t listen(int backlog);
 
+	// Get address of the peer side.
+	err_t peer(std::string* ip, uint16_t* port, bool* ipv6) const;
+	err_t peer(struct sockaddr_storage* addr) const;
+
 	err_t send(const void* buf, size_t size, size_t* ok_bytes);
 	err_t recv(void* buf, size_t size, size_t* ok_bytes);
 
+	// Receive data into several buffers in one system call.
+	err_t readv(const struct iovec* iov, int count, size_t* ok_bytes);
+
+	// Send data of several buffers in one system call.
+	err_t writev(const struct iovec* iov, int count, size_t* ok_bytes);
+
+	// Send "size" bytes of a file from "offset" without copying it
+	// to user space. Return EIO if the file ends before "size" bytes.
+	err_t sendfile(fd_t file, int64_t offset, size_t size, size_t* ok_bytes);
+
 	bool reuseaddr() const;
 	err_t reuseaddr(bool flag);
+
+	bool reuseport() const;
+	err_t reuseport(bool flag);
+
+	// Convert "struct sockaddr_storage" to ip string & port.
+	static err_t parse_addr(const struct sockaddr_storage* addr,
+		std::string* ip, uint16_t* port, bool* ipv6);
 };
 
 
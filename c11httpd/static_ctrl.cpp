@@ -0,0 +1,260 @@
+/**
+ * Static file controller.
+ *
+ * Copyright (c) 2015 Alex Jin (toalexjin@hotmail.com)
+ */
+
+#include "c11httpd/static_ctrl.h"
+#include "c11httpd/http_header.h"
+#include "c11httpd/http_status.h"
+#include "c11httpd/utility.h"
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+namespace c11httpd {
+
+
+static_ctrl_t::static_ctrl_t(const std::string& uri_root,
+	const std::string& dir,
+	size_t max_files,
+	const std::string& virtual_host)
+	: rest_ctrl_t(uri_root, virtual_host),
+	m_dir(dir),
+	m_max_files(max_files > 0 ? max_files : 1),
+	m_revalidate_ms(1000) {
+
+	// Remove tailing "/", because "/" is added before relative path.
+	while (this->m_dir.length() > 1 && this->m_dir[this->m_dir.length() - 1] == '/') {
+		this->m_dir.erase(this->m_dir.length() - 1);
+	}
+
+	this->add("/*", http_method_t::get, this, &static_ctrl_t::get_i);
+}
+
+static_ctrl_t::~static_ctrl_t() {
+	this->clear();
+}
+
+void static_ctrl_t::clear() {
+	std::lock_guard<std::mutex> lock(this->m_mutex);
+
+	this->m_files.clear();
+	this->m_lru.clear();
+}
+
+rest_result_t static_ctrl_t::get_i(ctx_setter_t& ctx_setter,
+	conn_session_t& session,
+	const http_request_t& request,
+	const std::vector<fast_str_t>& placeholders,
+	http_response_t& response) {
+
+	const fast_str_t relative = placeholders.empty() ? fast_str_t() : placeholders[0];
+
+	if (!safe_path_i(relative)) {
+		response.code(http_status_t::forbidden);
+		return rest_result_t::done;
+	}
+
+	std::string path = relative.to_str();
+	if (path.empty() || path[path.length() - 1] == '/') {
+		path += "index.html";
+	}
+
+	const auto file = this->open_i(path);
+	if (!file) {
+		response.code(http_status_t::not_found);
+		return rest_result_t::done;
+	}
+
+	// "If-None-Match" takes precedence over "If-Modified-Since".
+	const fast_str_t* const if_none_match = request.header(http_header_t::known_if_none_match);
+	const fast_str_t* const if_modified_since = request.header(http_header_t::known_if_modified_since);
+
+	if ((if_none_match != 0 && *if_none_match == file->m_etag)
+		|| (if_none_match == 0 && if_modified_since != 0
+			&& *if_modified_since == file->m_last_modified)) {
+		response << http_header_t(http_header_t::ETag, file->m_etag);
+		response.code(http_status_t::not_modified);
+		return rest_result_t::done;
+	}
+
+	response << http_header_t(http_header_t::Content_Type, file->m_content_type)
+		<< http_header_t(http_header_t::Last_Modified, file->m_last_modified)
+		<< http_header_t(http_header_t::ETag, file->m_etag);
+
+	// The response holds a reference, so the file is not closed
+	// until it has been sent (even if it's removed from cache).
+	response.write_file(file->m_fd, 0, file->m_size, [file]() {});
+
+	return rest_result_t::done;
+}
+
+std::shared_ptr<static_ctrl_t::file_t> static_ctrl_t::open_i(const std::string& path) {
+	const std::string full_path = this->m_dir + "/" + path;
+	const uint64_t now_ms = utility_t::now_ms();
+	std::shared_ptr<file_t> file;
+	bool fresh = false;
+	struct stat st;
+
+	do {
+		std::lock_guard<std::mutex> lock(this->m_mutex);
+
+		const auto it = this->m_files.find(path);
+		if (it != this->m_files.end()) {
+			// Move it to the beginning of LRU list.
+			this->m_lru.splice(this->m_lru.begin(), this->m_lru, it->second.m_lru);
+			file = it->second.m_file;
+			fresh = (now_ms - file->m_checked_ms < this->m_revalidate_ms);
+		}
+	} while (0);
+
+	// The path is not looked up again within "revalidate_ms", but the file
+	// could still be modified in place (e.g. truncated), so check the open
+	// file, otherwise "Content-Length" would be more than what could be sent.
+	if (fresh && ::fstat(file->m_fd.get(), &st) == 0 && same_i(*file, st)) {
+		return file;
+	}
+
+	// Check whether cached file was changed.
+	if (file) {
+		if (::stat(full_path.c_str(), &st) == 0 && same_i(*file, st)) {
+			std::lock_guard<std::mutex> lock(this->m_mutex);
+			file->m_checked_ms = now_ms;
+			return file;
+		}
+
+		file.reset();
+	}
+
+	const int fd = ::open(full_path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return file;
+	}
+
+	file = std::make_shared<file_t>();
+	file->m_fd = fd;
+
+	if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+		file.reset();
+		return file;
+	}
+
+	char buf[64];
+
+	file->m_size = size_t(st.st_size);
+	file->m_mtime = st.st_mtim.tv_sec;
+	file->m_mtime_ns = st.st_mtim.tv_nsec;
+	file->m_ino = st.st_ino;
+	file->m_checked_ms = now_ms;
+	file->m_content_type = content_type_i(path);
+
+	std::snprintf(buf, sizeof(buf), "\"%llx-%llx-%lx\"",
+		(unsigned long long) file->m_size,
+		(unsigned long long) file->m_mtime, (unsigned long) file->m_mtime_ns);
+	file->m_etag = buf;
+
+	utility_t::http_date(file->m_mtime, buf);
+	file->m_last_modified = buf;
+
+	this->cache_i(path, file);
+	return file;
+}
+
+void static_ctrl_t::cache_i(const std::string& path, const std::shared_ptr<file_t>& file) {
+	std::lock_guard<std::mutex> lock(this->m_mutex);
+
+	const auto it = this->m_files.find(path);
+	if (it != this->m_files.end()) {
+		it->second.m_file = file;
+		this->m_lru.splice(this->m_lru.begin(), this->m_lru, it->second.m_lru);
+		return;
+	}
+
+	// Remove the least recently used files.
+	while (this->m_files.size() >= this->m_max_files && !this->m_lru.empty()) {
+		this->m_files.erase(this->m_lru.back());
+		this->m_lru.pop_back();
+	}
+
+	this->m_lru.push_front(path);
+
+	entry_t& entry = this->m_files[path];
+	entry.m_file = file;
+	entry.m_lru = this->m_lru.begin();
+}
+
+bool static_ctrl_t::same_i(const file_t& file, const struct stat& st) {
+	return st.st_ino == file.m_ino
+		&& size_t(st.st_size) == file.m_size
+		&& st.st_mtim.tv_sec == file.m_mtime
+		&& st.st_mtim.tv_nsec == file.m_mtime_ns;
+}
+
+bool static_ctrl_t::safe_path_i(const fast_str_t& path) {
+	const char* pos = path.c_str();
+	const char* const end = path.c_str() + path.length();
+
+	while (pos != end) {
+		const char* last = pos;
+
+		while (last != end && *last != '/') {
+			if (*last == 0 || *last == '\\') {
+				return false;
+			}
+
+			++ last;
+		}
+
+		if (last - pos == 2 && pos[0] == '.' && pos[1] == '.') {
+			return false;
+		}
+
+		pos = (last == end) ? end : last + 1;
+	}
+
+	return true;
+}
+
+fast_str_t static_ctrl_t::content_type_i(const std::string& path) {
+	static const struct {
+		const char* m_ext;
+		fast_str_t m_type;
+	} types[] = {
+		{"html", http_header_t::Text_HTML_UTF8},
+		{"htm", http_header_t::Text_HTML_UTF8},
+		{"css", http_header_t::Text_CSS_UTF8},
+		{"js", http_header_t::Text_JavaScript},
+		{"json", http_header_t::App_Json_UTF8},
+		{"xml", http_header_t::App_XML_UTF8},
+		{"txt", http_header_t::Text_Plain_UTF8},
+		{"png", http_header_t::Image_PNG},
+		{"jpg", http_header_t::Image_JPEG},
+		{"jpeg", http_header_t::Image_JPEG},
+		{"gif", http_header_t::Image_GIF},
+		{"svg", "image/svg+xml"},
+		{"ico", "image/x-icon"},
+		{"zip", http_header_t::App_ZIP}
+	};
+
+	const auto dot = path.find_last_of("./");
+	if (dot != std::string::npos && path[dot] == '.') {
+		const fast_str_t ext(path.c_str() + dot + 1, path.length() - dot - 1);
+
+		for (const auto& item : types) {
+			if (ext.cmpi(item.m_ext) == 0) {
+				return item.m_type;
+			}
+		}
+	}
+
+	return http_header_t::App_Octet_Stream;
+}
+
+
+} // namespace c11httpd.
+
+
@@ -0,0 +1,146 @@
+/**
+ * Static file controller.
+ *
+ * Copyright (c) 2015 Alex Jin (toalexjin@hotmail.com)
+ */
+
+#pragma once
+
+#include "c11httpd/pre__.h"
+#include "c11httpd/fd.h"
+#include "c11httpd/rest_ctrl.h"
+#include <ctime>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+
+namespace c11httpd {
+
+
+// Static file controller.
+//
+// It maps URI root (e.g. "/static") to a directory, and serves
+// "GET <URI root>/<path>" with file "<directory>/<path>".
+// "index.html" is served if the path is empty or ends with "/".
+// <BR>
+//
+// Open files and their stat() results are cached in a bounded LRU cache
+// (shared by all worker threads), so a cached file costs no open() and
+// a stat() at most once per "revalidate_ms". File bodies are sent by
+// sendfile() (see http_response_t::write_file()).
+// <BR>
+//
+// Responses have "Content-Type" (by file extension), "Last-Modified"
+// and "ETag". "304 Not Modified" is returned if "If-None-Match" or
+// "If-Modified-Since" matches.
+class static_ctrl_t : public rest_ctrl_t {
+public:
+	// "max_files" is the max number of open files in cache.
+	static_ctrl_t(const std::string& uri_root,
+		const std::string& dir,
+		size_t max_files = 1024,
+		const std::string& virtual_host = std::string());
+
+	virtual ~static_ctrl_t();
+
+	// Directory of files.
+	const std::string& dir() const {
+		return this->m_dir;
+	}
+
+	size_t max_files() const {
+		return this->m_max_files;
+	}
+
+	// How long (in milliseconds) a cached stat() result is trusted
+	// before checking whether the file was changed.
+	uint32_t revalidate_ms() const {
+		return this->m_revalidate_ms;
+	}
+
+	void revalidate_ms(uint32_t value) {
+		this->m_revalidate_ms = value;
+	}
+
+	// Remove all files from cache.
+	void clear();
+
+private:
+	static_ctrl_t(const static_ctrl_t&) = delete;
+	static_ctrl_t& operator=(const static_ctrl_t&) = delete;
+
+	// An open file in cache.
+	//
+	// It's shared by the cache and responses being sent, so the file
+	// is closed after it's removed from cache and has been sent.
+	struct file_t {
+		file_t() : m_size(0), m_mtime(0), m_ino(0), m_mtime_ns(0), m_checked_ms(0) {
+		}
+
+		~file_t() {
+			this->m_fd.close();
+		}
+
+		fd_t m_fd;
+		size_t m_size;
+		std::time_t m_mtime;
+		ino_t m_ino;
+		long m_mtime_ns;
+		// Protected by "m_mutex", because it's updated after revalidation.
+		uint64_t m_checked_ms;
+		std::string m_etag;
+		std::string m_last_modified;
+		fast_str_t m_content_type;
+	};
+
+	typedef std::list<std::string> lru_t;
+
+	struct entry_t {
+		std::shared_ptr<file_t> m_file;
+		lru_t::iterator m_lru;
+	};
+
+	// GET handler.
+	rest_result_t get_i(ctx_setter_t& ctx_setter,
+		conn_session_t& session,
+		const http_request_t& request,
+		const std::vector<fast_str_t>& placeholders,
+		http_response_t& response);
+
+	// Get file from cache, or open it. Return null if it's not a regular file.
+	std::shared_ptr<file_t> open_i(const std::string& path);
+
+	// Put a file to cache, the least recently used file is removed if needed.
+	void cache_i(const std::string& path, const std::shared_ptr<file_t>& file);
+
+	// Check whether file status is the same as the cached file.
+	static bool same_i(const file_t& file, const struct stat& st);
+
+	// Check whether path (relative to "dir") is safe (no "..").
+	static bool safe_path_i(const fast_str_t& path);
+
+	// Get "Content-Type" by file extension.
+	static fast_str_t content_type_i(const std::string& path);
+
+private:
+	std::string m_dir;
+	size_t m_max_files;
+	uint32_t m_revalidate_ms;
+
+	// Cache, it's used by all worker threads.
+	std::mutex m_mutex;
+	std::unordered_map<std::string, entry_t> m_files;
+
+	// Paths in cache, most recently used first.
+	lru_t m_lru;
+};
+
+
+} // namespace c11httpd.
+
+
@@ -0,0 +1,99 @@
+/**
+ * Service statistics.
+ *
+ * Copyright (c) 2015 Alex Jin (toalexjin@hotmail.com)
+ */
+
+#pragma once
+
+#include "c11httpd/pre__.h"
+
+
+namespace c11httpd {
+
+
+// Service statistics.
+//
+// Each worker process (or worker thread) has its own statistics,
+// which are updated by acceptor_t's event loop.
+class stats_t {
+public:
+	stats_t() {
+		this->clear();
+	}
+
+	stats_t(const stats_t&) = default;
+	stats_t& operator=(const stats_t&) = default;
+
+	void clear() {
+		this->m_listen_wakeups = 0;
+		this->m_empty_wakeups = 0;
+		this->m_accepted = 0;
+		this->m_timeouts = 0;
+	}
+
+	// Number of times that listening sockets woke up the worker.
+	uint64_t listen_wakeups() const {
+		return this->m_listen_wakeups;
+	}
+
+	// Number of times that listening sockets woke up the worker
+	// but no connection was accepted (i.e. thundering herd).
+	uint64_t empty_wakeups() const {
+		return this->m_empty_wakeups;
+	}
+
+	// Number of accepted connections.
+	uint64_t accepted() const {
+		return this->m_accepted;
+	}
+
+	// Number of connections closed by timeouts
+	// (see config_t::keep_alive_timeout()).
+	uint64_t timeouts() const {
+		return this->m_timeouts;
+	}
+
+	// Average wakeups per accepted connection.
+	//
+	// A value much greater than 1 means the worker is often
+	// woken up by connections that are accepted by other workers.
+	double wakeups_per_accept() const {
+		return this->m_accepted == 0 ? 0.0
+			: double(this->m_listen_wakeups) / double(this->m_accepted);
+	}
+
+	// Add another statistics (e.g. from a worker thread).
+	void add(const stats_t& another) {
+		this->m_listen_wakeups += another.m_listen_wakeups;
+		this->m_empty_wakeups += another.m_empty_wakeups;
+		this->m_accepted += another.m_accepted;
+		this->m_timeouts += another.m_timeouts;
+	}
+
+	// A listening socket woke up the worker and "accepted"
+	// connections were accepted.
+	void on_listen_wakeup(uint64_t accepted) {
+		this->m_listen_wakeups++;
+		this->m_accepted += accepted;
+
+		if (accepted == 0) {
+			this->m_empty_wakeups++;
+		}
+	}
+
+	// A connection timed out.
+	void on_timeout() {
+		this->m_timeouts++;
+	}
+
+private:
+	uint64_t m_listen_wakeups;
+	uint64_t m_empty_wakeups;
+	uint64_t m_accepted;
+	uint64_t m_timeouts;
+};
+
+
+} // namespace c11httpd.
+
@@ -0,0 +1,206 @@
+/**
+ * Hierarchical timer wheel.
+ *
+ * Copyright (c) 2015 Alex Jin (toalexjin@hotmail.com)
+ */
+
+#include "c11httpd/timer_wheel.h"
+#include "c11httpd/utility.h"
+#include <climits>
+
+
+namespace c11httpd {
+
+
+timer_wheel_t::timer_wheel_t(uint32_t tick_ms) : m_tick_ms(tick_ms) {
+	assert(tick_ms > 0);
+
+	this->m_now_ms = utility_t::now_ms();
+	this->m_now = this->m_now_ms / this->m_tick_ms;
+
+	for (int i = 0; i < levels; ++i) {
+		this->m_bitmaps[i] = 0;
+	}
+}
+
+timer_wheel_t::~timer_wheel_t() {
+	// Nodes are owned by other objects, just detach them.
+	for (int i = 0; i < levels; ++i) {
+		for (int k = 0; k < slots; ++k) {
+			auto& head = this->m_slots[i][k];
+
+			while (head.linked()) {
+				head.next()->unlink();
+			}
+		}
+	}
+}
+
+void timer_wheel_t::start(timer_node_t* node, uint64_t timeout_ms) {
+	const uint64_t max_ticks = (uint64_t(1) << (slot_bits * levels)) - 1;
+
+	assert(node != 0);
+
+	node->cancel();
+
+	// The event loop might have slept for a long time since last advance(),
+	// so count from current time. Round up, so that a timer never expires
+	// earlier than expected.
+	uint64_t expire = (utility_t::now_ms() + timeout_ms + this->m_tick_ms - 1) / this->m_tick_ms;
+
+	if (expire <= this->m_now) {
+		expire = this->m_now + 1;
+	} else if (expire - this->m_now > max_ticks) {
+		expire = this->m_now + max_ticks;
+	}
+
+	node->m_expire = expire;
+	this->insert_i(node);
+}
+
+void timer_wheel_t::advance(uint64_t now_ms,
+	const std::function<void(timer_node_t*)>& on_expired) {
+	if (now_ms <= this->m_now_ms) {
+		return;
+	}
+
+	this->m_now_ms = now_ms;
+	const uint64_t target = now_ms / this->m_tick_ms;
+
+	while (this->m_now < target) {
+		bool empty = true;
+
+		for (int i = 0; i < levels; ++i) {
+			if (this->m_bitmaps[i] != 0) {
+				empty = false;
+				break;
+			}
+		}
+
+		// Nothing to do, jump to the target directly.
+		if (empty) {
+			this->m_now = target;
+			break;
+		}
+
+		++ this->m_now;
+
+		// Level N wraps around every 64^N ticks.
+		for (int i = 1; i < levels; ++i) {
+			if ((this->m_now & ((uint64_t(1) << (slot_bits * i)) - 1)) != 0) {
+				break;
+			}
+
+			this->cascade_i(i);
+		}
+
+		const int slot = int(this->m_now & slot_mask);
+		auto& head = this->m_slots[0][slot];
+
+		while (head.linked()) {
+			timer_node_t* const node = head.next()->get();
+
+			node->m_link.unlink();
+			on_expired(node);
+		}
+
+		// Callbacks never add timers to the current slot
+		// (expiration time is at least one tick later).
+		this->m_bitmaps[0] &= ~(uint64_t(1) << slot);
+	}
+}
+
+int timer_wheel_t::next_timeout_ms() {
+	uint64_t nearest = 0;
+	bool found = false;
+
+	for (int i = 0; i < levels; ++i) {
+		uint64_t tick;
+
+		if (this->next_due_i(i, &tick) && (!found || tick < nearest)) {
+			nearest = tick;
+			found = true;
+		}
+	}
+
+	if (!found) {
+		return -1;
+	}
+
+	const uint64_t due_ms = nearest * this->m_tick_ms;
+	if (due_ms <= this->m_now_ms) {
+		return 0;
+	}
+
+	if (due_ms - this->m_now_ms > uint64_t(INT_MAX)) {
+		return INT_MAX;
+	}
+
+	return int(due_ms - this->m_now_ms);
+}
+
+void timer_wheel_t::insert_i(timer_node_t* node) {
+	const uint64_t diff = node->m_expire > this->m_now ? node->m_expire - this->m_now : 0;
+	int level = 0;
+
+	while (level < levels - 1 && diff >= (uint64_t(1) << (slot_bits * (level + 1)))) {
+		++ level;
+	}
+
+	const int slot = int((node->m_expire >> (slot_bits * level)) & slot_mask);
+
+	node->m_level = level;
+	node->m_slot = slot;
+	this->m_slots[level][slot].push_back(&node->m_link);
+	this->m_bitmaps[level] |= (uint64_t(1) << slot);
+}
+
+void timer_wheel_t::cascade_i(int level) {
+	const int slot = int((this->m_now >> (slot_bits * level)) & slot_mask);
+	auto& head = this->m_slots[level][slot];
+
+	// All timers of the slot expire within 64^level ticks,
+	// so they always go to lower levels.
+	while (head.linked()) {
+		timer_node_t* const node = head.next()->get();
+
+		node->m_link.unlink();
+		this->insert_i(node);
+	}
+
+	this->m_bitmaps[level] &= ~(uint64_t(1) << slot);
+}
+
+bool timer_wheel_t::next_due_i(int level, uint64_t* tick) {
+	const int shift = slot_bits * level;
+	const int pos = int((this->m_now >> shift) & slot_mask);
+
+	while (this->m_bitmaps[level] != 0) {
+		// Rotate bitmap, so that bit 0 is the slot right after current one.
+		const int rotate = (pos + 1) & slot_mask;
+		const uint64_t bitmap = this->m_bitmaps[level];
+		const uint64_t rotated = rotate == 0 ? bitmap
+			: ((bitmap >> rotate) | (bitmap << (slots - rotate)));
+
+		const int distance = __builtin_ctzll(rotated) + 1;
+		const int slot = (pos + distance) & slot_mask;
+
+		if (!this->m_slots[level][slot].linked()) {
+			// All timers of the slot were cancelled.
+			this->m_bitmaps[level] &= ~(uint64_t(1) << slot);
+			continue;
+		}
+
+		// Level 0 slot expires at that tick, higher level slot
+		// is cascaded when lower bits of current tick become zero.
+		*tick = ((this->m_now >> shift) + distance) << shift;
+		return true;
+	}
+
+	return false;
+}
+
+
+} // namespace c11httpd.
+
+
@@ -0,0 +1,156 @@
+/**
+ * Hierarchical timer wheel.
+ *
+ * Copyright (c) 2015 Alex Jin (toalexjin@hotmail.com)
+ */
+
+#pragma once
+
+#include "c11httpd/pre__.h"
+#include "c11httpd/link.h"
+#include <functional>
+
+
+namespace c11httpd {
+
+
+class timer_wheel_t;
+
+
+// Timer node.
+//
+// It's embedded in the object that needs a timeout (e.g. conn_t),
+// so starting or cancelling a timer never allocates memory.
+class timer_node_t {
+public:
+	explicit timer_node_t(void* owner)
+		: m_link(uintptr_t(&this->m_link) - uintptr_t(this)) {
+		this->m_owner = owner;
+		this->m_expire = 0;
+		this->m_level = 0;
+		this->m_slot = 0;
+	}
+
+	~timer_node_t() {
+		this->cancel();
+	}
+
+	// The object that the timer belongs to.
+	void* owner() const {
+		return this->m_owner;
+	}
+
+	// Timer is started and has not expired yet.
+	bool active() const {
+		return this->m_link.linked();
+	}
+
+	// Stop timer. It's safe to call it even if timer is not active.
+	void cancel() {
+		this->m_link.unlink();
+	}
+
+private:
+	timer_node_t(const timer_node_t&) = delete;
+	timer_node_t& operator=(const timer_node_t&) = delete;
+
+	friend class timer_wheel_t;
+
+private:
+	link_t<timer_node_t> m_link;
+	void* m_owner;
+
+	// Expiration time (in ticks).
+	uint64_t m_expire;
+
+	// Where the node is.
+	int m_level;
+	int m_slot;
+};
+
+
+// Hierarchical timer wheel.
+//
+// There are "levels" wheels, each of them has 64 slots. A slot of level 0
+// covers one tick, a slot of level N covers 64^N ticks. Timers in higher
+// levels are moved down (cascaded) when lower level wraps around, so
+// starting, cancelling and expiring a timer are all O(1).
+// <BR>
+//
+// Each level has a bitmap of non-empty slots, so the nearest expiration
+// time (i.e. how long the event loop could sleep) is found quickly.
+// <BR>
+//
+// timer_wheel_t is used by one event loop only, it's not thread-safe.
+class timer_wheel_t {
+public:
+	enum {
+		levels = 4,
+		slot_bits = 6,
+		slots = (1 << slot_bits),
+		slot_mask = slots - 1
+	};
+
+	// "tick_ms" is timer resolution (in milliseconds).
+	explicit timer_wheel_t(uint32_t tick_ms = 100);
+	~timer_wheel_t();
+
+	// Get timer resolution (in milliseconds).
+	uint32_t tick_ms() const {
+		return this->m_tick_ms;
+	}
+
+	// Time (in milliseconds) of last advance().
+	uint64_t now_ms() const {
+		return this->m_now_ms;
+	}
+
+	// Start (or restart) a timer, which expires after "timeout_ms" milliseconds.
+	//
+	// Timeout is rounded up to tick, and the max timeout is 64^levels ticks.
+	void start(timer_node_t* node, uint64_t timeout_ms);
+
+	// Move forward to "now_ms" (see utility_t::now_ms()),
+	// and call "on_expired" for each expired timer.
+	//
+	// A timer is not active any more when "on_expired" is called,
+	// which could start (or cancel) any timer.
+	void advance(uint64_t now_ms, const std::function<void(timer_node_t*)>& on_expired);
+
+	// Get how many milliseconds until the nearest timer expires.
+	//
+	// Return -1 if there is no active timer (i.e. epoll_wait() timeout).
+	int next_timeout_ms();
+
+private:
+	timer_wheel_t(const timer_wheel_t&) = delete;
+	timer_wheel_t& operator=(const timer_wheel_t&) = delete;
+
+	// Put a node to the right slot based on its expiration time.
+	void insert_i(timer_node_t* node);
+
+	// Move timers of current slot of "level" down to lower levels.
+	void cascade_i(int level);
+
+	// Get the tick when the nearest non-empty slot of "level" is due,
+	// or return false if the level is empty.
+	bool next_due_i(int level, uint64_t* tick);
+
+private:
+	const uint32_t m_tick_ms;
+	uint64_t m_now_ms;
+
+	// Current tick. Slot of current tick of level 0 has been handled.
+	uint64_t m_now;
+
+	link_t<timer_node_t> m_slots[levels][slots];
+
+	// Bit "i" is on if slot "i" might be non-empty. Bits of slots
+	// emptied by timer_node_t::cancel() are cleared lazily.
+	uint64_t m_bitmaps[levels];
+};
+
+
+} // namespace c11httpd.
+
+
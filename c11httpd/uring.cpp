@@ -0,0 +1,346 @@
+/**
+ * A lightweight io_uring wrapper.
+ *
+ * Copyright (c) 2015 Alex Jin (toalexjin@hotmail.com)
+ */
+
+#include "c11httpd/uring.h"
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+
+namespace c11httpd {
+
+
+uring_t::uring_t() {
+	this->m_sq_ring = MAP_FAILED;
+	this->m_sq_ring_size = 0;
+	this->m_cq_ring = MAP_FAILED;
+	this->m_cq_ring_size = 0;
+	this->m_sqes = (struct io_uring_sqe*) MAP_FAILED;
+	this->m_sqes_size = 0;
+
+	this->m_sq_head = 0;
+	this->m_sq_tail = 0;
+	this->m_sq_mask = 0;
+	this->m_sq_entries = 0;
+	this->m_sq_local_tail = 0;
+
+	this->m_cq_head = 0;
+	this->m_cq_tail = 0;
+	this->m_cq_mask = 0;
+	this->m_cqes = 0;
+
+	this->m_buf_ring = (struct io_uring_buf_ring*) MAP_FAILED;
+	this->m_buf_ring_size = 0;
+	this->m_bufs = (char*) MAP_FAILED;
+	this->m_buf_count = 0;
+	this->m_buf_size = 0;
+	this->m_buf_tail = 0;
+}
+
+uring_t::~uring_t() {
+	this->close();
+}
+
+err_t uring_t::open(unsigned entries) {
+	err_t ret;
+	struct io_uring_params params;
+
+	assert(!this->is_open());
+	assert(entries > 0);
+
+	bzero(&params, sizeof(params));
+
+	// Only the event loop thread submits requests, so kernel
+	// does not need to interrupt it to run completion work.
+	params.flags = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_COOP_TASKRUN;
+
+	const int fd = (int) syscall(__NR_io_uring_setup, entries, &params);
+	if (fd < 0) {
+		return err_t::current();
+	}
+
+	this->m_fd = fd;
+
+	this->m_sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	this->m_cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+	// Since Linux kernel 5.4, both rings could be mapped in one call.
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		if (this->m_cq_ring_size > this->m_sq_ring_size) {
+			this->m_sq_ring_size = this->m_cq_ring_size;
+		}
+
+		this->m_cq_ring_size = 0;
+	}
+
+	this->m_sq_ring = mmap(0, this->m_sq_ring_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if (this->m_sq_ring == MAP_FAILED) {
+		ret.set_current();
+		goto clean;
+	}
+
+	if (this->m_cq_ring_size == 0) {
+		this->m_cq_ring = this->m_sq_ring;
+	} else {
+		this->m_cq_ring = mmap(0, this->m_cq_ring_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+		if (this->m_cq_ring == MAP_FAILED) {
+			ret.set_current();
+			goto clean;
+		}
+	}
+
+	this->m_sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+	this->m_sqes = (struct io_uring_sqe*) mmap(0, this->m_sqes_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	if (this->m_sqes == MAP_FAILED) {
+		ret.set_current();
+		goto clean;
+	}
+
+	do {
+		char* const sq = (char*) this->m_sq_ring;
+		char* const cq = (char*) this->m_cq_ring;
+
+		this->m_sq_head = (unsigned*) (sq + params.sq_off.head);
+		this->m_sq_tail = (unsigned*) (sq + params.sq_off.tail);
+		this->m_sq_mask = *(unsigned*) (sq + params.sq_off.ring_mask);
+		this->m_sq_entries = params.sq_entries;
+		this->m_sq_local_tail = *this->m_sq_tail;
+
+		// Submission queue entry "i" is always at array index "i".
+		unsigned* const array = (unsigned*) (sq + params.sq_off.array);
+		for (unsigned i = 0; i < params.sq_entries; ++i) {
+			array[i] = i;
+		}
+
+		this->m_cq_head = (unsigned*) (cq + params.cq_off.head);
+		this->m_cq_tail = (unsigned*) (cq + params.cq_off.tail);
+		this->m_cq_mask = *(unsigned*) (cq + params.cq_off.ring_mask);
+		this->m_cqes = (struct io_uring_cqe*) (cq + params.cq_off.cqes);
+	} while (0);
+
+clean:
+
+	if (!ret) {
+		this->close();
+	}
+
+	return ret;
+}
+
+void uring_t::close() {
+	// Close file handle first, so that kernel stops using the buffers.
+	this->m_fd.close();
+
+	if (this->m_sqes != MAP_FAILED) {
+		munmap(this->m_sqes, this->m_sqes_size);
+		this->m_sqes = (struct io_uring_sqe*) MAP_FAILED;
+	}
+
+	if (this->m_cq_ring != MAP_FAILED && this->m_cq_ring != this->m_sq_ring) {
+		munmap(this->m_cq_ring, this->m_cq_ring_size);
+	}
+
+	this->m_cq_ring = MAP_FAILED;
+
+	if (this->m_sq_ring != MAP_FAILED) {
+		munmap(this->m_sq_ring, this->m_sq_ring_size);
+		this->m_sq_ring = MAP_FAILED;
+	}
+
+	this->free_bufs_i();
+
+	this->m_sq_head = 0;
+	this->m_sq_tail = 0;
+	this->m_cq_head = 0;
+	this->m_cq_tail = 0;
+	this->m_cqes = 0;
+}
+
+struct io_uring_sqe* uring_t::get_sqe() {
+	assert(this->is_open());
+
+	unsigned head = __atomic_load_n(this->m_sq_head, __ATOMIC_ACQUIRE);
+
+	if (this->m_sq_local_tail - head >= this->m_sq_entries) {
+		// Submission queue is full, submit pending entries first.
+		if (!this->submit(0)) {
+			return 0;
+		}
+
+		head = __atomic_load_n(this->m_sq_head, __ATOMIC_ACQUIRE);
+		if (this->m_sq_local_tail - head >= this->m_sq_entries) {
+			return 0;
+		}
+	}
+
+	auto sqe = &this->m_sqes[this->m_sq_local_tail & this->m_sq_mask];
+	++ this->m_sq_local_tail;
+
+	bzero(sqe, sizeof(*sqe));
+	return sqe;
+}
+
+err_t uring_t::submit(unsigned wait_nr, int timeout_ms) {
+	struct io_uring_getevents_arg arg;
+	struct __kernel_timespec ts;
+	unsigned enter_flags = 0;
+	void* enter_arg = 0;
+	size_t enter_arg_size = 0;
+
+	assert(this->is_open());
+
+	// Publish new entries to kernel.
+	__atomic_store_n(this->m_sq_tail, this->m_sq_local_tail, __ATOMIC_RELEASE);
+
+	const unsigned to_submit = this->m_sq_local_tail
+		- __atomic_load_n(this->m_sq_head, __ATOMIC_ACQUIRE);
+
+	if (to_submit == 0 && wait_nr == 0) {
+		return err_t();
+	}
+
+	if (wait_nr > 0) {
+		enter_flags |= IORING_ENTER_GETEVENTS;
+
+		if (timeout_ms >= 0) {
+			bzero(&arg, sizeof(arg));
+			ts.tv_sec = timeout_ms / 1000;
+			ts.tv_nsec = (long long) (timeout_ms % 1000) * 1000000;
+			arg.ts = (uint64_t) (uintptr_t) &ts;
+
+			enter_flags |= IORING_ENTER_EXT_ARG;
+			enter_arg = &arg;
+			enter_arg_size = sizeof(arg);
+		}
+	}
+
+	const int result = (int) syscall(__NR_io_uring_enter, this->m_fd.get(),
+		to_submit, wait_nr, enter_flags, enter_arg, enter_arg_size);
+	if (result < 0) {
+		return err_t::current();
+	}
+
+	return err_t();
+}
+
+const struct io_uring_cqe* uring_t::peek_cqe() const {
+	assert(this->is_open());
+
+	const unsigned head = *this->m_cq_head;
+	const unsigned tail = __atomic_load_n(this->m_cq_tail, __ATOMIC_ACQUIRE);
+
+	if (head == tail) {
+		return 0;
+	}
+
+	return &this->m_cqes[head & this->m_cq_mask];
+}
+
+void uring_t::cqe_seen() {
+	assert(this->is_open());
+
+	__atomic_store_n(this->m_cq_head, *this->m_cq_head + 1, __ATOMIC_RELEASE);
+}
+
+err_t uring_t::add_bufs(unsigned count, unsigned size) {
+	err_t ret;
+	struct io_uring_buf_reg reg;
+	unsigned entries = 1;
+
+	assert(this->is_open());
+	assert(this->m_buf_count == 0);
+	assert(count > 0 && count <= 32768);
+	assert(size > 0);
+
+	// Number of entries must be a power of 2.
+	while (entries < count) {
+		entries <<= 1;
+	}
+
+	this->m_buf_ring_size = entries * sizeof(struct io_uring_buf);
+	this->m_buf_ring = (struct io_uring_buf_ring*) mmap(0, this->m_buf_ring_size,
+		PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (this->m_buf_ring == MAP_FAILED) {
+		ret = err_t::current();
+		goto clean;
+	}
+
+	this->m_bufs = (char*) mmap(0, size_t(entries) * size,
+		PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (this->m_bufs == MAP_FAILED) {
+		ret = err_t::current();
+		goto clean;
+	}
+
+	// Size of "m_bufs" is known, so free_bufs_i() could unmap it.
+	this->m_buf_count = entries;
+	this->m_buf_size = size;
+	this->m_buf_tail = 0;
+
+	bzero(&reg, sizeof(reg));
+	reg.ring_addr = (uint64_t) (uintptr_t) this->m_buf_ring;
+	reg.ring_entries = entries;
+	reg.bgid = buf_group;
+
+	if (syscall(__NR_io_uring_register, this->m_fd.get(),
+		IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+		ret = err_t::current();
+		goto clean;
+	}
+
+	for (unsigned i = 0; i < entries; ++i) {
+		this->recycle_buf(uint16_t(i));
+	}
+
+clean:
+	if (!ret) {
+		this->free_bufs_i();
+	}
+
+	return ret;
+}
+
+void uring_t::free_bufs_i() {
+	if (this->m_buf_ring != MAP_FAILED) {
+		munmap(this->m_buf_ring, this->m_buf_ring_size);
+		this->m_buf_ring = (struct io_uring_buf_ring*) MAP_FAILED;
+	}
+
+	if (this->m_bufs != MAP_FAILED) {
+		munmap(this->m_bufs, size_t(this->m_buf_count) * this->m_buf_size);
+		this->m_bufs = (char*) MAP_FAILED;
+	}
+
+	this->m_buf_count = 0;
+	this->m_buf_size = 0;
+	this->m_buf_tail = 0;
+}
+
+void uring_t::recycle_buf(uint16_t bid) {
+	assert(bid < this->m_buf_count);
+
+	// Do not use "m_buf_ring->bufs", in C++ the empty struct generated by
+	// __DECLARE_FLEX_ARRAY() takes one byte, so the array is misplaced.
+	auto item = (struct io_uring_buf*) this->m_buf_ring
+		+ (this->m_buf_tail & (this->m_buf_count - 1));
+
+	item->addr = (uint64_t) (uintptr_t) this->buf(bid);
+	item->len = this->m_buf_size;
+	item->bid = bid;
+
+	++ this->m_buf_tail;
+	__atomic_store_n(&this->m_buf_ring->tail, this->m_buf_tail, __ATOMIC_RELEASE);
+}
+
+
+} // namespace c11httpd.
+
+
@@ -0,0 +1,120 @@
+/**
+ * A lightweight io_uring wrapper.
+ *
+ * Copyright (c) 2015 Alex Jin (toalexjin@hotmail.com)
+ */
+
+#pragma once
+
+#include "c11httpd/pre__.h"
+#include "c11httpd/err.h"
+#include "c11httpd/fd.h"
+#include <linux/io_uring.h>
+
+
+namespace c11httpd {
+
+
+// A lightweight io_uring wrapper.
+//
+// uring_t talks to Linux kernel via raw system calls, so liburing
+// is not required. It also manages one ring of provided buffers
+// (group uring_t::buf_group), which is used by multishot recv.
+// <BR>
+//
+// uring_t is used by one event loop only, it's not thread-safe.
+class uring_t {
+public:
+	// Group id of provided buffers.
+	static const uint16_t buf_group = 0;
+
+public:
+	uring_t();
+	~uring_t();
+
+	// Create io_uring with at least "entries" submission queue entries.
+	err_t open(unsigned entries);
+
+	// Close io_uring and free provided buffers.
+	void close();
+
+	bool is_open() const {
+		return this->m_fd.is_open();
+	}
+
+	// Get a free submission queue entry (all fields are zero).
+	//
+	// If submission queue is full, pending entries are submitted first.
+	// Return 0 if it still fails.
+	struct io_uring_sqe* get_sqe();
+
+	// Submit pending entries, and wait for at least "wait_nr" completions.
+	//
+	// If "timeout_ms" is not negative, waiting stops after the timeout
+	// and ETIME is returned.
+	err_t submit(unsigned wait_nr, int timeout_ms = -1);
+
+	// Get next completion queue entry, return 0 if there is none.
+	const struct io_uring_cqe* peek_cqe() const;
+
+	// The entry returned by peek_cqe() has been handled.
+	void cqe_seen();
+
+	// Register provided buffers.
+	//
+	// "count" is rounded up to a power of 2.
+	err_t add_bufs(unsigned count, unsigned size);
+
+	// Get a provided buffer.
+	char* buf(uint16_t bid) const {
+		assert(bid < this->m_buf_count);
+		return this->m_bufs + size_t(bid) * this->m_buf_size;
+	}
+
+	// Give a provided buffer back to Linux kernel.
+	void recycle_buf(uint16_t bid);
+
+private:
+	uring_t(const uring_t&) = delete;
+	uring_t& operator=(const uring_t&) = delete;
+
+	// Unmap provided buffers.
+	void free_bufs_i();
+
+private:
+	fd_t m_fd;
+
+	// Mapped rings.
+	void* m_sq_ring;
+	size_t m_sq_ring_size;
+	void* m_cq_ring;
+	size_t m_cq_ring_size;
+	struct io_uring_sqe* m_sqes;
+	size_t m_sqes_size;
+
+	// Submission queue.
+	unsigned* m_sq_head;
+	unsigned* m_sq_tail;
+	unsigned m_sq_mask;
+	unsigned m_sq_entries;
+	unsigned m_sq_local_tail;
+
+	// Completion queue.
+	unsigned* m_cq_head;
+	unsigned* m_cq_tail;
+	unsigned m_cq_mask;
+	struct io_uring_cqe* m_cqes;
+
+	// Provided buffers.
+	struct io_uring_buf_ring* m_buf_ring;
+	size_t m_buf_ring_size;
+	char* m_bufs;
+	unsigned m_buf_count;
+	unsigned m_buf_size;
+	uint16_t m_buf_tail;
+};
+
+
+} // namespace c11httpd.
+
+
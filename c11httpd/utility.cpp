@@ -12,12 +12,15 @@ namespace c11httpd {
 
 
 void utility_t::response_date(char* str) {
-	auto now = std::time(0);
+	http_date(std::time(0), str);
+}
+
+void utility_t::http_date(std::time_t time, char* str) {
 	struct tm now_tm;
 	struct tm* now_tm_ptr;
 	const char* format = "%a, %d %b %Y %H:%M:%S GMT";
 
-	now_tm_ptr = gmtime_r(&now, &now_tm);
+	now_tm_ptr = gmtime_r(&time, &now_tm);
 	if (now_tm_ptr == 0) {
 		str[0] = 0;
 		return;
@@ -30,6 +33,13 @@ void utility_t::response_date(char* str) {
 	}
 }
 
+uint64_t utility_t::now_ms() {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return uint64_t(ts.tv_sec) * 1000 + uint64_t(ts.tv_nsec) / 1000000;
+}
+
 
 } // namespace c11httpd.
 
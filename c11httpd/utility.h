@@ -7,6 +7,7 @@
 #pragma once
 
 #include "c11httpd/pre__.h"
+#include <ctime>
 
 
 namespace c11httpd {
@@ -24,6 +25,14 @@ public:
 	// Get current GMT time for HTTP response header "Date:???".
 	static void response_date(char* str);
 
+	// Format a time in HTTP date format (e.g. "Last-Modified:???"),
+	// "str" has "response_date_len" characters.
+	static void http_date(std::time_t time, char* str);
+
+	// Get monotonic time (in milliseconds), which is not affected
+	// by system time changes.
+	static uint64_t now_ms();
+
 private:
 	utility_t() = delete;
 };
@@ -13,8 +13,8 @@ namespace c11httpd {
 
 // Waitable interface.
 //
-// epoll could monitor listening-socket, connection-socket and signal.
-// This is the base class/interface of these three types of objects.
+// epoll could monitor listening-socket, connection-socket, signal and event fd.
+// This is the base class/interface of these types of objects.
 class waitable_t {
 public:
 	enum type_t {
@@ -25,7 +25,13 @@ public:
 		type_conn,
 
 		// Linux signals.
-		type_signal
+		type_signal,
+
+		// Event fd (notification from another thread).
+		type_event,
+
+		// aio_queue_t (completed AIO tasks).
+		type_aio
 	};
 
 public: